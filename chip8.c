@@ -1,4 +1,3 @@
-#include <emscripten.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -6,9 +5,15 @@
 #include <time.h>
 #include <unistd.h>
 #include "chip8.h"
+#include "debugger.h"
 #include "opcode.h"
 
-struct chip8 chip8;
+struct chip8 chip8 = {.memory = chip8.baseMemory, .memSize = MEM_SIZE,
+                      .heldKey = -1, .rngState = 1};
+
+// Allocated the first time XO-CHIP mode is selected so that the other
+// modes keep their 4 KB footprint
+static uint8_t *xoMemory;
 
 uint8_t fontset[80] = {
     0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
@@ -31,11 +36,57 @@ uint8_t fontset[80] = {
 
 void loadFont() { memcpy(&chip8.memory[0x050], fontset, 80); }
 
+// Default XO-CHIP audio pattern, a square wave
+uint8_t defaultPattern[XO_AUDIO_SIZE] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+void resetAudio() {
+    memcpy(chip8.audioPattern, defaultPattern, XO_AUDIO_SIZE);
+    chip8.pitch = 64;
+}
+
+// Point chip8.memory at the 4 KB or 64 KB buffer, carrying the
+// low 4 KB across so a mode switch doesn't lose the machine state
+int selectMemory(int xo) {
+    uint8_t *target = chip8.baseMemory;
+    uint32_t size = MEM_SIZE;
+    if (xo) {
+        if (!xoMemory) xoMemory = calloc(1, XO_MEM_SIZE);
+        if (!xoMemory) {
+            fprintf(stderr, "Unable to allocate XO-CHIP memory\n");
+            return 0;
+        }
+        target = xoMemory;
+        size = XO_MEM_SIZE;
+    }
+    if (target != chip8.memory) {
+        memcpy(target, chip8.memory, MEM_SIZE);
+        if (size > MEM_SIZE) {
+            memset(&target[MEM_SIZE], 0, size - MEM_SIZE);
+            // reload() skips ROMs that don't fit in 4 KB, so one loaded
+            // before the switch has to be copied in now
+            if (chip8.programSize > MEM_SIZE - 0x200)
+                memcpy(&target[0x200], chip8.program, chip8.programSize);
+        }
+        chip8.memory = target;
+        chip8.memSize = size;
+    }
+    return 1;
+}
+
+void convertDisplay(int toXo);
+
 //Set quirks based on mode
 // 0: Standard mode
 // 1: Super-CHIP mode
+// 2: XO-CHIP mode
 void setMode(int mode) {
     if (mode == 0) {
+        selectMemory(0);
+        if (chip8.xochip) convertDisplay(0);
+        chip8.xochip = 0;
         chip8.hires = 0;
         chip8.setXOnShift = 1;
         chip8.vfReset = 1;
@@ -43,27 +94,96 @@ void setMode(int mode) {
         chip8.jumpx = 0;
         chip8.displayUpdate = 1;
     } else if (mode == 1) {
+        selectMemory(0);
+        if (chip8.xochip) convertDisplay(0);
+        chip8.xochip = 0;
         chip8.setXOnShift = 0;
         chip8.vfReset = 0;
         chip8.memoryInc = 0;
         chip8.jumpx = 1;
         chip8.displayUpdate = 1;
+    } else if (mode == 2) {
+        if (!selectMemory(1)) return;
+        if (!chip8.xochip) convertDisplay(1);
+        chip8.xochip = 1;
+        chip8.hires = 0;
+        chip8.setXOnShift = 1;
+        chip8.vfReset = 0;
+        chip8.memoryInc = 1;
+        chip8.jumpx = 0;
+        chip8.displayUpdate = 1;
     } else {
-        printf("Unknown mode %d\n", mode);
+        fprintf(stderr, "Unknown mode %d\n", mode);
     }
 }
 
 void chip8Init() {
+    chip8.memory = chip8.baseMemory;
+    chip8.memSize = MEM_SIZE;
     chip8.programCounter = 0x200;
+    chip8.planeMask = 1;
+    chip8.heldKey = -1;
     loadFont();
-    srand(time(NULL));
+    resetAudio();
+    chip8Seed(time(NULL));
     setMode(0);
 }
 
-uint8_t *getDisplay() { return chip8.display; }
+// Expand the XO-CHIP bitplanes into the byte per pixel display buffer
+void composeDisplay() {
+    int width = chip8.hires ? 128 : 64;
+    int height = chip8.hires ? 64 : 32;
+    for (int y = 0; y < height; y++) {
+        uint8_t *row = &chip8.display[y * width];
+        for (int x = 0; x < width; x++) {
+            int word = x >> 6;
+            int shift = 63 - (x & 63);
+            uint8_t color = 0;
+            for (int p = 0; p < XO_PLANES; p++) {
+                color |= ((chip8.planes[p][y][word] >> shift) & 1) << p;
+            }
+            row[x] = color;
+        }
+    }
+    chip8.planesDirty = 0;
+}
+
+/*
+    Carry the screen across a switch into or out of XO-CHIP mode
+    Lit pixels move to plane 0 on the way in. On the way out every
+    colour becomes 1, as the other modes XOR the display with 1
+*/
+void convertDisplay(int toXo) {
+    int width = chip8.hires ? 128 : 64;
+    int height = chip8.hires ? 64 : 32;
+    if (toXo) {
+        memset(chip8.planes, 0, sizeof(chip8.planes));
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                if (chip8.display[y * width + x])
+                    chip8.planes[0][y][x >> 6] |= 1ULL << (63 - (x & 63));
+            }
+        }
+        chip8.planesDirty = 1;
+    } else {
+        if (chip8.planesDirty) composeDisplay();
+        for (int i = 0; i < DISPLAY_WIDTH * DISPLAY_HEIGHT; i++) {
+            chip8.display[i] = chip8.display[i] != 0;
+        }
+        memset(chip8.planes, 0, sizeof(chip8.planes));
+        chip8.planesDirty = 0;
+    }
+    chip8.displayUpdate = 1;
+}
+
+uint8_t *getDisplay() {
+    if (chip8.planesDirty) composeDisplay();
+    return chip8.display;
+}
 
 int isDisplayUpdated() {
     if (chip8.displayUpdate) {
+        if (chip8.planesDirty) composeDisplay();
         chip8.displayUpdate = 0;
         return 1;
     }
@@ -83,12 +203,14 @@ void chip8_release_key(int key) {
 }
 
 void reload() {
-    memset(chip8.memory, 0, sizeof(chip8.memory));
+    memset(chip8.memory, 0, chip8.memSize);
     memset(chip8.display, 0, sizeof(chip8.display));
+    memset(chip8.planes, 0, sizeof(chip8.planes));
     memset(chip8.registers, 0, sizeof(chip8.registers));
     memset(chip8.stack, 0, sizeof(chip8.stack));
     loadFont();
-    if (chip8.programSize > 0 && chip8.programSize <= (MEM_SIZE - 0x200)) {
+    resetAudio();
+    if (chip8.programSize > 0 && chip8.programSize <= (int)(chip8.memSize - 0x200)) {
         memcpy(&chip8.memory[0x200], chip8.program, chip8.programSize);
     }
     chip8.programCounter = 0x200;
@@ -96,27 +218,94 @@ void reload() {
     chip8.delayTimer = 0;
     chip8.soundTimer = 0;
     chip8.sp = 0;
+    chip8.heldKey = -1;
+    chip8.planeMask = 1;
+    chip8.planesDirty = chip8.xochip;
     chip8.displayUpdate = 1;
 }
 
-void loadROM(uint8_t *data, int length) {
-    memcpy(&chip8.program, data, length);
+void loadROMInPlace(const uint8_t *data, int length) {
+    if (length < 0 || length > XO_MEM_SIZE - 0x200) {
+        fprintf(stderr, "ROM too large %d\n", length);
+        return;
+    }
+    chip8.program = data;
     chip8.programSize = length;
     reload();
 }
 
+void loadROM(uint8_t *data, int length) {
+    if (length < 0 || length > XO_MEM_SIZE - 0x200) {
+        fprintf(stderr, "ROM too large %d\n", length);
+        return;
+    }
+    uint8_t *program = realloc(chip8.programBuffer, length ? length : 1);
+    if (!program) {
+        fprintf(stderr, "Unable to allocate ROM buffer\n");
+        return;
+    }
+    memcpy(program, data, length);
+    chip8.programBuffer = program;
+    loadROMInPlace(program, length);
+}
+
 void pauseChip() { chip8.isPaused = chip8.isPaused ? 0 : 1; }
 
 void chip8Tick() {
     if (chip8.delayTimer > 0) chip8.delayTimer--;
+    if (chip8.soundTimer > 0) chip8.soundTimer--;
 }
 
 int isHiresMode() { return chip8.hires; }
 
+void chip8Seed(uint32_t seed) { chip8.rngState = seed ? seed : 1; }
+
+// xorshift32, kept in the machine state so rollback replays the same values
+uint8_t chip8Random() {
+    uint32_t x = chip8.rngState;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    chip8.rngState = x;
+    return x >> 24;
+}
+
+void saveState(struct chip8Snapshot *snapshot) {
+    memcpy(&snapshot->machine, &chip8, sizeof(chip8));
+    memcpy(snapshot->memory, chip8.memory, chip8.memSize);
+}
+
+void loadState(const struct chip8Snapshot *snapshot) {
+    const uint8_t *program = chip8.program;
+    uint8_t *programBuffer = chip8.programBuffer;
+    int programSize = chip8.programSize;
+
+    if (snapshot->machine.memSize != chip8.memSize
+        && !selectMemory(snapshot->machine.memSize > MEM_SIZE))
+        return;
+    uint8_t *memory = chip8.memory;
+    memcpy(&chip8, &snapshot->machine, sizeof(chip8));
+    chip8.memory = memory;
+    chip8.program = program;
+    chip8.programBuffer = programBuffer;
+    chip8.programSize = programSize;
+    memcpy(chip8.memory, snapshot->memory, chip8.memSize);
+    chip8.displayUpdate = 1;
+}
+
+uint8_t *getAudioPattern() { return chip8.audioPattern; }
+
+int getAudioPitch() { return chip8.pitch; }
+
+int getSoundTimer() { return chip8.soundTimer; }
+
 void chip8Cycle() {
     if (chip8.isPaused) return;
-    uint16_t opcode = chip8.memory[chip8.programCounter] << 8
-                      | chip8.memory[chip8.programCounter + 1];
+    uint16_t opcode = chip8.memory[MEM_WRAP(chip8.programCounter)] << 8
+                      | chip8.memory[MEM_WRAP(chip8.programCounter + 1)];
+#ifndef CHIP8_NO_DEBUGGER
+    if (debugger.active && debugBeforeExecute(opcode)) return;
+#endif
     chip8.programCounter += 2;
     chip8_decode_and_execute(opcode);
 }
\ No newline at end of file
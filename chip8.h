@@ -6,7 +6,9 @@
     against the implementation file.
     This emulator is based on the Chip8 specification and is compatible with
     most Chip8 ROMs. It also includes support for Super-CHIP mode, which adds
-    additional opcodes and features to the original Chip8 specification.
+    additional opcodes and features to the original Chip8 specification, and
+    XO-CHIP mode, which adds a 64 KB address space, up to four bitplanes and
+    a programmable audio pattern.
 
     To use this emulator, you must implement the event loop and rendering
     logic in your application. You must call the `chip8Tick` and `chip8Cycle` functions
@@ -27,8 +29,8 @@
     and `chip8_release_key` functions can be used to handle input from the
     keyboard. These functions should be called when a key is pressed or released,
     and will update the internal state of the emulator accordingly. The
-    `setMode` function can be used to switch between standard Chip8 mode and
-    Super-CHIP mode. The emulator will automatically adjust its behavior based
+    `setMode` function can be used to switch between standard Chip8 mode,
+    Super-CHIP mode and XO-CHIP mode. The emulator will automatically adjust its behavior based
     on the selected mode. The `isHiresMode` function can be used to check if
     the emulator is currently in high-resolution mode. The `pauseChip` function
     can be used to pause or unpause the emulator. When the emulator is paused,
@@ -42,6 +44,9 @@
 #include <stdint.h>
 
 #define MEM_SIZE 4096
+#define XO_MEM_SIZE 65536
+#define XO_PLANES 4
+#define XO_AUDIO_SIZE 16
 #define KEY_SIZE 16
 #define NUM_REGISTERS 16
 #define DISPLAY_WIDTH 128
@@ -49,13 +54,27 @@
 #define STACK_SIZE 16
 #define NUM_KEYS 16
 #define PIXEL_SIZE 10
+#define DISPLAY_WORDS (DISPLAY_WIDTH / 64) // 64-bit words per plane row
+
+// Wrap an address into the memory in use, so I-relative accesses near the
+// top of the 4 KB modes can't run past it. memSize is a power of 2
+#define MEM_WRAP(address) ((address) & (chip8.memSize - 1))
 
 struct chip8 {
-    uint8_t memory[MEM_SIZE];
-    uint8_t program[MEM_SIZE];
+    uint8_t *memory;   // baseMemory, or the 64 KB XO-CHIP memory
+    uint32_t memSize;  // size of the buffer memory points to
+    uint8_t baseMemory[MEM_SIZE];
+    const uint8_t *program;  // last loaded ROM, used by reload()
+    uint8_t *programBuffer;  // heap copy made by loadROM
     uint8_t registers[NUM_REGISTERS];
     uint16_t stack[STACK_SIZE];
     uint8_t display[DISPLAY_WIDTH * DISPLAY_HEIGHT];
+    // XO-CHIP bitplanes, one bit per pixel, column 0 in the MSB of word 0
+    uint64_t planes[XO_PLANES][DISPLAY_HEIGHT][DISPLAY_WORDS];
+    uint8_t planeMask;  // planes selected by FN01
+    int planesDirty;    // planes changed since display was last composed
+    uint8_t audioPattern[XO_AUDIO_SIZE];
+    uint8_t pitch;
     uint8_t key[NUM_KEYS];
     uint8_t sp; // stack pointer
     uint16_t programCounter;
@@ -71,6 +90,16 @@ struct chip8 {
     int jumpx;       // Jump opcode uses Vx instead of V0
     int clip;
     int hires;
+    int xochip;      // XO-CHIP opcodes, 64 KB memory and bitplanes
+    int heldKey;     // key FX0A is waiting to be released, -1 if none
+    uint32_t rngState; // CXNN random number state
+};
+
+// A copy of the full machine state, used for rollback
+// Only the memory that is in use for the current mode is copied
+struct chip8Snapshot {
+    struct chip8 machine;
+    uint8_t memory[XO_MEM_SIZE];
 };
 
 extern struct chip8 chip8;
@@ -80,8 +109,14 @@ extern struct chip8 chip8;
 void chip8Init();
 
 //Load a ROM into the emulator
+//The data is copied, so the caller may free it afterwards
 void loadROM(uint8_t *data, int length);
 
+//Load a ROM without copying it
+//The data must stay valid until another ROM is loaded,
+//as reload() reads it again
+void loadROMInPlace(const uint8_t *data, int length);
+
 // Reset the emulator state
 // This will reload the last loaded ROM
 void reload();
@@ -89,6 +124,21 @@ void reload();
 // Call tick 60 times per second
 void chip8Tick();
 
+// Seed the CXNN random number generator
+// chip8Init seeds it from the clock; peers that must stay in
+// lockstep seed it with the same value after loading a ROM
+void chip8Seed(uint32_t seed);
+
+// returns the next CXNN random byte
+uint8_t chip8Random();
+
+// Save the machine state into snapshot
+void saveState(struct chip8Snapshot *snapshot);
+
+// Restore a state saved by saveState
+// The loaded ROM is kept, so reload() still restarts the current ROM
+void loadState(const struct chip8Snapshot *snapshot);
+
 // Call cycle N times per tick
 void chip8Cycle();
 
@@ -96,6 +146,7 @@ void chip8Cycle();
     Set mode for the chip8 emulator.
     0: Standard mode
     1: Super-CHIP mode
+    2: XO-CHIP mode
 */
 void setMode(int mode);
 
@@ -113,6 +164,8 @@ int isHiresMode();
 //you must check isHiresMode() to know the size of the display
 //if the display is in low-res mode, the size is 64 * 32 and
 //only the first 64 * 32 bytes of the display buffer are used
+//in XO-CHIP mode each byte holds a colour index from 0 to 15,
+//bit N being set when the pixel is lit on plane N
 uint8_t *getDisplay();
 
 //returns 1 if the display has been updated
@@ -122,4 +175,15 @@ int isDisplayUpdated();
 // pause the emulator or unpause it if paused
 void pauseChip();
 
+// returns a pointer to the XO_AUDIO_SIZE byte XO-CHIP audio pattern
+// the pattern is played one bit at a time while the sound timer is nonzero
+uint8_t *getAudioPattern();
+
+// returns the XO-CHIP pitch register
+// playback rate is 4000 * 2^((pitch - 64) / 48) bits per second
+int getAudioPitch();
+
+// returns the current value of the sound timer
+int getSoundTimer();
+
 #endif
\ No newline at end of file
@@ -0,0 +1,311 @@
+/*
+    chip8test.c
+    Regression tests for the emulator core, run natively with make test.
+    Each test loads a small program, runs it and checks the machine state.
+*/
+
+#include "chip8.h"
+#include "debugger.h"
+#include "opcode.h"
+#include "netplay.h"
+#include "recorder.h"
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+int failures = 0;
+
+#define CHECK(cond)                                                        \
+    do {                                                                   \
+        if (!(cond)) {                                                     \
+            fprintf(stderr, "%s:%d: %s failed\n", __FILE__, __LINE__,     \
+                    #cond);                                                \
+            failures++;                                                    \
+        }                                                                  \
+    } while (0)
+
+void run(int mode, uint8_t *program, int length, int cycles) {
+    chip8Init();
+    chip8.isPaused = 0;
+    setMode(mode);
+    loadROM(program, length);
+    for (int i = 0; i < cycles; i++) {
+        chip8Cycle();
+    }
+}
+
+// A skip over F000 NNNN skips all four bytes
+void testSkipLongInstruction() {
+    uint8_t program[] = {
+        0x30, 0x00,             // skip if V0 == 0
+        0xF0, 0x00, 0x20, 0x00, // I = 0x2000, skipped
+        0x61, 0x01,             // V1 = 1
+    };
+    run(2, program, sizeof(program), 2);
+    CHECK(chip8.programCounter == 0x208);
+    CHECK(chip8.registers[1] == 1);
+    CHECK(chip8.indexRegister == 0);
+}
+
+// A skip over a short instruction skips two bytes even when F000 follows it
+void testSkipBeforeLongInstruction() {
+    uint8_t program[] = {
+        0x30, 0x00,             // skip if V0 == 0
+        0x61, 0x01,             // V1 = 1, skipped
+        0xF0, 0x00, 0x03, 0x00, // I = 0x300
+    };
+    run(2, program, sizeof(program), 2);
+    CHECK(chip8.programCounter == 0x208);
+    CHECK(chip8.registers[1] == 0);
+    CHECK(chip8.indexRegister == 0x300);
+}
+
+// A ROM too large for 4 KB is mapped in full when XO-CHIP is selected
+void testLargeRomThenXoChip() {
+    static uint8_t program[8000];
+    memset(program, 0x01, sizeof(program));
+    program[sizeof(program) - 1] = 0x02;
+    run(0, program, sizeof(program), 0);
+    setMode(2);
+    CHECK(chip8.memory[0x200] == 0x01);
+    CHECK(chip8.memory[0x200 + sizeof(program) - 1] == 0x02);
+}
+
+// FX55 at the top of 4 KB wraps instead of writing past memory
+void testStoreAtTopOfMemory() {
+    uint8_t program[] = {
+        0xAF, 0xFF, // I = 0xFFF
+        0xFF, 0x55, // store V0-VF
+    };
+    run(0, program, sizeof(program), 2);
+    CHECK(chip8.program != NULL);
+    reload();
+    CHECK(chip8.memory[0x200] == 0xAF);
+}
+
+// A breakpoint on an odd address doesn't stop at the even one before it
+void testOddBreakpoint() {
+    uint8_t program[] = {
+        0x12, 0x05,       // jump to 0x205
+        0x00, 0x00, 0x00, // padding
+        0x60, 0x01,       // 0x205: V0 = 1
+        0x12, 0x07,       // loop
+    };
+    debugSetBreakpoint(0x201, 1);
+    debugSetBreakpoint(0x205, 1);
+    run(0, program, sizeof(program), 4);
+    CHECK(debugTakeStopReason() == DEBUG_STOP_BREAKPOINT);
+    CHECK(debugger.stopAddress == 0x205);
+    CHECK(chip8.registers[0] == 0);
+    debugClearBreakpoints();
+}
+
+// Sprite data read by DXYN triggers a read watchpoint
+void testSpriteWatchpoint() {
+    uint8_t program[] = {
+        0xA2, 0x06, // I = 0x206
+        0xD0, 0x01, // draw 1 row
+        0x12, 0x04, // loop
+        0xFF,
+    };
+    int slot = debugAddWatchpoint(0x206, 1, DEBUG_WATCH_READ);
+    run(0, program, sizeof(program), 3);
+    CHECK(debugTakeStopReason() == DEBUG_STOP_WATCH_READ);
+    CHECK(chip8.programCounter == 0x204);
+    debugRemoveWatchpoint(slot);
+}
+
+// Recording a ROM and decoding it with player gives back the last frame
+void testRecordAndPlay(int mode) {
+    static uint8_t program[XO_MEM_SIZE];
+    static char output[1 << 16];
+    const char *path = "chip8test.c8r";
+    const char *colors = " #23456789ABCDEF";
+
+    FILE *f = fopen("roms/spaceinvaders.ch8", "rb");
+    CHECK(f != NULL);
+    if (!f) return;
+    int length = fread(program, 1, sizeof(program), f);
+    fclose(f);
+
+    run(mode, program, length, 0);
+    CHECK(recorderOpen(path));
+    for (int frame = 0; frame < 2000; frame++) {
+        chip8.key[5] = frame % 90 < 30; // fire now and then
+        for (int i = 0; i < 8; i++) {
+            chip8Cycle();
+        }
+        chip8Tick();
+        recorderFrame();
+    }
+    recorderClose();
+
+    FILE *player = popen("./player chip8test.c8r 0", "r");
+    CHECK(player != NULL);
+    if (!player) return;
+    int size = fread(output, 1, sizeof(output) - 1, player);
+    pclose(player);
+    remove(path);
+    output[size] = 0;
+
+    // the player homes the cursor, then prints one line per row
+    int width = isHiresMode() ? 128 : 64;
+    int height = isHiresMode() ? 64 : 32;
+    uint8_t *display = getDisplay();
+    char *line = strstr(output, "\033[H");
+    CHECK(line != NULL);
+    if (!line) return;
+    line += 3;
+    int mismatches = 0;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            if (line[x] != colors[display[y * width + x]]) mismatches++;
+        }
+        line += width + 1;
+    }
+    CHECK(mismatches == 0);
+}
+
+// The screen survives switching into and out of XO-CHIP
+void testModeSwitchKeepsScreen() {
+    uint8_t program[] = {
+        0xA2, 0x06, // I = 0x206
+        0xD0, 0x01, // draw 1 row at 0,0
+        0x12, 0x04, // loop
+        0xF0,       // sprite
+    };
+    run(0, program, sizeof(program), 2);
+    setMode(2);
+    CHECK(getDisplay()[0] == 1);
+    CHECK(getDisplay()[4] == 0);
+
+    // draw the sprite again on plane 1 only, giving colour 3
+    chip8.planeMask = 2;
+    chip8_decode_and_execute(0xD001);
+    CHECK(getDisplay()[0] == 3);
+
+    setMode(0);
+    CHECK(getDisplay()[0] == 1);
+    // the same sprite erases it again, reporting a collision
+    chip8_decode_and_execute(0xD001);
+    CHECK(getDisplay()[0] == 0);
+    CHECK(chip8.registers[0xF] == 1);
+}
+
+// Run frames with a fixed key schedule, key 5 held two frames in six
+void runFrames(int from, int to) {
+    for (int frame = from; frame < to; frame++) {
+        chip8.key[5] = frame % 6 < 2;
+        for (int i = 0; i < 8; i++) {
+            chip8Cycle();
+        }
+        chip8Tick();
+    }
+}
+
+// Restoring a snapshot and rerunning the same input gives the same state
+void testSnapshotReplay() {
+    static struct chip8Snapshot start, first, second;
+    uint8_t program[] = {
+        0xC0, 0xFF, // V0 = random
+        0xC1, 0xFF, // V1 = random
+        0xF2, 0x0A, // wait for a key press and release
+        0xA3, 0x00, // I = 0x300
+        0xF1, 0x55, // store V0-V1
+        0x73, 0x01, // V3 += 1
+        0x12, 0x00, // loop
+    };
+    run(0, program, sizeof(program), 0);
+    chip8Seed(1234);
+    runFrames(0, 10);
+    saveState(&start);
+    runFrames(10, 100);
+    saveState(&first);
+    loadState(&start);
+    runFrames(10, 100);
+    saveState(&second);
+
+    CHECK(first.machine.registers[3] > 5); // FX0A let the loop run
+    CHECK(memcmp(&first.machine, &second.machine, sizeof(first.machine))
+          == 0);
+    CHECK(memcmp(first.memory, second.memory, MEM_SIZE) == 0);
+}
+
+// FX55 wrapping past the top of 4 KB fires a watch on address 0
+void testWrappedWatchpoint() {
+    uint8_t program[] = {
+        0xAF, 0xFE, // I = 0xFFE
+        0xF3, 0x55, // store V0-V3 at 0xFFE-0x001
+    };
+    int slot = debugAddWatchpoint(0x000, 1, DEBUG_WATCH_WRITE);
+    run(0, program, sizeof(program), 2);
+    CHECK(debugTakeStopReason() == DEBUG_STOP_WATCH_WRITE);
+    CHECK(debugger.stopAddress == 0x000);
+    debugRemoveWatchpoint(slot);
+}
+
+// A remote peer that is already ahead doesn't stall the local one
+void testNetplayRemoteAhead() {
+    uint8_t program[] = {0x12, 0x00}; // loop
+    struct sockaddr_in remote = {0}, local;
+    socklen_t length = sizeof(remote);
+    uint8_t packet[NETPLAY_PACKET_SIZE];
+    int frames = 30;
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    remote.sin_family = AF_INET;
+    remote.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(sock, (struct sockaddr *)&remote, sizeof(remote));
+    getsockname(sock, (struct sockaddr *)&remote, &length);
+
+    run(0, program, sizeof(program), 0);
+    CHECK(netplayStart(0, 0, "127.0.0.1", ntohs(remote.sin_port), 8));
+
+    // the first frame tells the remote where to send its input
+    CHECK(netplayFrame(0));
+    length = sizeof(local);
+    recvfrom(sock, packet, sizeof(packet), 0, (struct sockaddr *)&local,
+             &length);
+
+    memset(packet, 0, sizeof(packet));
+    memcpy(packet, NETPLAY_MAGIC, 4);
+    packet[4] = NETPLAY_VERSION;
+    packet[5] = 1;
+    memset(&packet[6], 0xFF, 4); // nothing acked yet
+    packet[14] = frames;         // inputs for frames 0 to 29 start at 0
+    sendto(sock, packet, 15 + frames * 2, 0, (struct sockaddr *)&local,
+           length);
+    usleep(20000);
+
+    // the remote is 29 frames ahead, so the next 40 frames all run
+    for (int i = 0; i < 40; i++) {
+        netplayFrame(0);
+    }
+    CHECK(netplayCurrentFrame() == 41);
+    netplayStop();
+    close(sock);
+}
+
+int main() {
+    testSkipLongInstruction();
+    testSkipBeforeLongInstruction();
+    testLargeRomThenXoChip();
+    testStoreAtTopOfMemory();
+    testOddBreakpoint();
+    testSpriteWatchpoint();
+    testWrappedWatchpoint();
+    testModeSwitchKeepsScreen();
+    testSnapshotReplay();
+    testRecordAndPlay(0);
+    testRecordAndPlay(1);
+    testRecordAndPlay(2);
+    testNetplayRemoteAhead();
+    if (failures) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("all tests passed\n");
+    return 0;
+}
@@ -0,0 +1,123 @@
+#include "debugger.h"
+#include <string.h>
+
+struct chip8Debugger debugger = {.resumeAddress = 0xFFFFFFFF};
+
+static void updateActive() {
+    debugger.active = debugger.breakpointCount || debugger.watchpointCount
+                      || debugger.trace;
+}
+
+void debugSetBreakpoint(uint16_t address, int enabled) {
+    uint8_t *byte = &debugger.breakpoints[address >> 3];
+    uint8_t bit = 1 << (address & 7);
+    if (enabled && !(*byte & bit)) {
+        *byte |= bit;
+        debugger.breakpointCount++;
+    } else if (!enabled && (*byte & bit)) {
+        *byte &= ~bit;
+        debugger.breakpointCount--;
+    }
+    updateActive();
+}
+
+void debugClearBreakpoints() {
+    memset(debugger.breakpoints, 0, sizeof(debugger.breakpoints));
+    debugger.breakpointCount = 0;
+    updateActive();
+}
+
+int debugAddWatchpoint(uint16_t address, uint16_t length, int flags) {
+    if (!length || !(flags & (DEBUG_WATCH_READ | DEBUG_WATCH_WRITE)))
+        return -1;
+    for (int i = 0; i < DEBUG_MAX_WATCHPOINTS; i++) {
+        if (debugger.watchpoints[i].flags) continue;
+        debugger.watchpoints[i].address = address;
+        debugger.watchpoints[i].length = length;
+        debugger.watchpoints[i].flags = flags;
+        debugger.watchpointCount++;
+        updateActive();
+        return i;
+    }
+    return -1;
+}
+
+void debugRemoveWatchpoint(int slot) {
+    if (slot < 0 || slot >= DEBUG_MAX_WATCHPOINTS) return;
+    if (!debugger.watchpoints[slot].flags) return;
+    debugger.watchpoints[slot].flags = 0;
+    debugger.watchpointCount--;
+    updateActive();
+}
+
+void debugSetTrace(int enabled) {
+    debugger.trace = enabled;
+    updateActive();
+}
+
+int debugTraceCount() {
+    return debugger.traceHead < DEBUG_TRACE_SIZE ? (int)debugger.traceHead
+                                                 : DEBUG_TRACE_SIZE;
+}
+
+const struct debugTraceEntry *debugTraceGet(int age) {
+    if (age < 0 || age >= debugTraceCount()) return 0;
+    return &debugger.traceRing[(debugger.traceHead - 1 - age)
+                               & (DEBUG_TRACE_SIZE - 1)];
+}
+
+int debugTakeStopReason() {
+    int reason = debugger.stopReason;
+    debugger.stopReason = DEBUG_STOP_NONE;
+    return reason;
+}
+
+void debugStop(int reason, uint16_t address) {
+    debugger.stopReason = reason;
+    debugger.stopAddress = address;
+    chip8.isPaused = 1;
+}
+
+int debugBeforeExecute(uint16_t opcode) {
+    uint16_t pc = MEM_WRAP(chip8.programCounter); // the address fetched
+
+    if (debugger.breakpoints[pc >> 3] & (1 << (pc & 7))) {
+        if (debugger.resumeAddress != pc) {
+            // stop here, and run this opcode once execution resumes
+            debugger.resumeAddress = pc;
+            debugStop(DEBUG_STOP_BREAKPOINT, pc);
+            return 1;
+        }
+    }
+    debugger.resumeAddress = 0xFFFFFFFF;
+
+    if (debugger.trace) {
+        struct debugTraceEntry *entry
+            = &debugger.traceRing[debugger.traceHead & (DEBUG_TRACE_SIZE - 1)];
+        entry->programCounter = pc;
+        entry->opcode = opcode;
+        entry->indexRegister = chip8.indexRegister;
+        entry->sp = chip8.sp;
+        memcpy(entry->registers, chip8.registers, NUM_REGISTERS);
+        debugger.traceHead++;
+    }
+    return 0;
+}
+
+void debugMemoryAccess(uint16_t address, int length, int flags) {
+    for (int i = 0; i < DEBUG_MAX_WATCHPOINTS; i++) {
+        struct debugWatchpoint *w = &debugger.watchpoints[i];
+        if (!(w->flags & flags)) continue;
+        // compare as offsets modulo the memory in use, so ranges that
+        // wrap past the top of memory still match
+        uint32_t mask = chip8.memSize - 1;
+        uint32_t start = (address - w->address) & mask;
+        uint32_t end = (start + length - 1) & mask;
+        if (start < w->length || start > end) {
+            debugStop(flags & DEBUG_WATCH_WRITE ? DEBUG_STOP_WATCH_WRITE
+                                                : DEBUG_STOP_WATCH_READ,
+                      start < w->length ? address : MEM_WRAP(w->address));
+            return;
+        }
+    }
+}
@@ -0,0 +1,115 @@
+/*
+    Debugger hooks for the Chip8 emulator
+    Breakpoints, memory watchpoints and a trace of recently executed opcodes.
+    Watchpoints cover every access through I: FX33, FX55, FX65, 5XY2,
+    5XY3, F002 and the sprite data read by DXYN.
+    While nothing is set the only cost per cycle is a test of debugger.active.
+    Building with -DCHIP8_NO_DEBUGGER removes the hooks entirely.
+
+    When a breakpoint or watchpoint is hit the emulator is paused and the
+    reason is kept in debugger.stopReason. A breakpoint stops before the
+    opcode at its address runs; calling pauseChip() resumes from it. A
+    watchpoint stops after the opcode that touched the watched memory.
+*/
+
+#ifndef CHIP8_DEBUGGER_H
+#define CHIP8_DEBUGGER_H
+
+#include "chip8.h"
+#include <stdint.h>
+
+// one bit per address, as jumps may land on odd addresses
+#define DEBUG_BREAKPOINT_BYTES (XO_MEM_SIZE / 8)
+#define DEBUG_MAX_WATCHPOINTS 8
+#define DEBUG_TRACE_SIZE 64 // must be a power of 2
+
+// watchpoint flags
+#define DEBUG_WATCH_READ 1
+#define DEBUG_WATCH_WRITE 2
+
+// stop reasons
+#define DEBUG_STOP_NONE 0
+#define DEBUG_STOP_BREAKPOINT 1
+#define DEBUG_STOP_WATCH_READ 2
+#define DEBUG_STOP_WATCH_WRITE 3
+#define DEBUG_STOP_UNKNOWN_OPCODE 4
+
+struct debugWatchpoint {
+    uint16_t address;
+    uint16_t length;
+    uint8_t flags; // DEBUG_WATCH_READ and/or DEBUG_WATCH_WRITE, 0 if unused
+};
+
+// machine state just before an opcode was executed
+struct debugTraceEntry {
+    uint16_t programCounter;
+    uint16_t opcode;
+    uint16_t indexRegister;
+    uint8_t sp;
+    uint8_t registers[NUM_REGISTERS];
+};
+
+struct chip8Debugger {
+    int active; // nonzero while any breakpoint, watchpoint or trace is on
+    int breakpointCount;
+    int watchpointCount;
+    int trace;
+    uint32_t resumeAddress; // breakpoint to step over after a resume
+    uint8_t breakpoints[DEBUG_BREAKPOINT_BYTES];
+    struct debugWatchpoint watchpoints[DEBUG_MAX_WATCHPOINTS];
+    struct debugTraceEntry traceRing[DEBUG_TRACE_SIZE];
+    uint32_t traceHead; // total entries written, the ring wraps
+    int stopReason;
+    uint16_t stopAddress; // breakpoint/opcode address, or watched address
+};
+
+extern struct chip8Debugger debugger;
+
+// set or clear a breakpoint on the opcode at address
+void debugSetBreakpoint(uint16_t address, int enabled);
+
+void debugClearBreakpoints();
+
+// watch length bytes from address for reads and/or writes
+// returns the watchpoint slot, or -1 if all slots are in use
+int debugAddWatchpoint(uint16_t address, uint16_t length, int flags);
+
+void debugRemoveWatchpoint(int slot);
+
+// record every executed opcode in the trace ring
+void debugSetTrace(int enabled);
+
+// number of entries available in the trace ring
+int debugTraceCount();
+
+// returns a trace entry, 0 being the most recently executed opcode
+const struct debugTraceEntry *debugTraceGet(int age);
+
+// returns the reason for the last stop and clears it
+int debugTakeStopReason();
+
+/*
+    Hooks called by the emulator core
+    These are only called while debugger.active is set
+*/
+
+// called before each opcode, returns 1 if execution should stop
+int debugBeforeExecute(uint16_t opcode);
+
+// called when an opcode accesses length bytes of memory at address
+// address must already be wrapped with MEM_WRAP
+void debugMemoryAccess(uint16_t address, int length, int flags);
+
+// called by the unknown opcode paths, which pause the emulator
+void debugStop(int reason, uint16_t address);
+
+#ifdef CHIP8_NO_DEBUGGER
+#define DEBUG_MEMORY_ACCESS(address, length, flags)
+#else
+#define DEBUG_MEMORY_ACCESS(address, length, flags)                         \
+    do {                                                                   \
+        if (debugger.active) debugMemoryAccess(address, length, flags);    \
+    } while (0)
+#endif
+
+#endif
@@ -0,0 +1,68 @@
+/*
+    headless.c
+    Runs the Chip8 emulator without a window and records the display with
+    the frame stream recorder. Emulation is not throttled, so long runs
+    finish as fast as the emulator and recorder allow.
+
+    Usage: headless program.ch8 out.c8r [frames] [mode] [cycles per frame]
+    Use "-" as the output to write the recording to stdout.
+*/
+
+#include "chip8.h"
+#include "recorder.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+void loadProgram(char *filename) {
+    static uint8_t program[XO_MEM_SIZE - 0x200];
+    FILE *f = fopen(filename, "rb");
+    if (!f) {
+        perror("Error opening file");
+        exit(1);
+    }
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    rewind(f);
+
+    if (size > (long)sizeof(program)) {
+        fprintf(stderr, "ROM too large: %ld bytes\n", size);
+        exit(1);
+    }
+    fread(&program, 1, size, f);
+    loadROM(program, size);
+    fclose(f);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        fprintf(stderr,
+                "Usage: %s program.ch8 out.c8r [frames] [mode] [cycles]\n",
+                argv[0]);
+        return 1;
+    }
+    long frames = argc > 3 ? atol(argv[3]) : 3600;
+    int mode = argc > 4 ? atoi(argv[4]) : 0;
+    int cycles = argc > 5 ? atoi(argv[5]) : 8;
+
+    chip8Init();
+    setMode(mode);
+    loadProgram(argv[1]);
+    if (!recorderOpen(argv[2])) return 1;
+
+    clock_t start = clock();
+    for (long frame = 0; frame < frames; frame++) {
+        for (int i = 0; i < cycles; i++) {
+            chip8Cycle();
+        }
+        chip8Tick();
+        recorderFrame();
+    }
+    recorderClose();
+
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    fprintf(stderr, "%ld frames in %.3fs (%.0f frames/s)\n", frames, seconds,
+            seconds > 0 ? frames / seconds : 0);
+    return 0;
+}
@@ -6,6 +6,8 @@
 */
 
 #include "chip8.h"
+#include "debugger.h"
+#include "rombundle.h"
 #include <emscripten.h>
 
 EMSCRIPTEN_KEEPALIVE
@@ -19,6 +21,11 @@ void chip8_load_rom_emscripten(uint8_t *data, int length) {
     loadROM(data, length);
 }
 
+EMSCRIPTEN_KEEPALIVE
+int chip8_load_bundled_rom_emscripten(const char *name) {
+    return loadBundledROM(name);
+}
+
 EMSCRIPTEN_KEEPALIVE
 void chip8_tick_emscripten() { chip8Tick(); }
 
@@ -44,4 +51,49 @@ EMSCRIPTEN_KEEPALIVE
 int chip8_is_hires_emscripten() { return isHiresMode(); }
 
 EMSCRIPTEN_KEEPALIVE
-void chip8_pause_emscripten() { pauseChip(); }
\ No newline at end of file
+void chip8_pause_emscripten() { pauseChip(); }
+
+EMSCRIPTEN_KEEPALIVE
+uint8_t *chip8_get_audio_pattern_emscripten() { return getAudioPattern(); }
+
+EMSCRIPTEN_KEEPALIVE
+int chip8_get_audio_pitch_emscripten() { return getAudioPitch(); }
+
+EMSCRIPTEN_KEEPALIVE
+int chip8_get_sound_timer_emscripten() { return getSoundTimer(); }
+
+EMSCRIPTEN_KEEPALIVE
+void chip8_debug_set_breakpoint_emscripten(int address, int enabled) {
+    debugSetBreakpoint(address, enabled);
+}
+
+EMSCRIPTEN_KEEPALIVE
+void chip8_debug_clear_breakpoints_emscripten() { debugClearBreakpoints(); }
+
+EMSCRIPTEN_KEEPALIVE
+int chip8_debug_add_watchpoint_emscripten(int address, int length, int flags) {
+    return debugAddWatchpoint(address, length, flags);
+}
+
+EMSCRIPTEN_KEEPALIVE
+void chip8_debug_remove_watchpoint_emscripten(int slot) {
+    debugRemoveWatchpoint(slot);
+}
+
+EMSCRIPTEN_KEEPALIVE
+void chip8_debug_set_trace_emscripten(int enabled) { debugSetTrace(enabled); }
+
+EMSCRIPTEN_KEEPALIVE
+int chip8_debug_trace_count_emscripten() { return debugTraceCount(); }
+
+// returns a pointer to a struct debugTraceEntry, see debugger.h for layout
+EMSCRIPTEN_KEEPALIVE
+const struct debugTraceEntry *chip8_debug_trace_entry_emscripten(int age) {
+    return debugTraceGet(age);
+}
+
+EMSCRIPTEN_KEEPALIVE
+int chip8_debug_stop_reason_emscripten() { return debugTakeStopReason(); }
+
+EMSCRIPTEN_KEEPALIVE
+int chip8_debug_stop_address_emscripten() { return debugger.stopAddress; }
@@ -1,9 +1,49 @@
 import createModule from './core.js';
 
-createModule().then((Module) => {
+const WASM_URL = 'core.wasm';
+const WASM_CACHE = 'chipwasm-core';
+
+/*
+    Fetch core.wasm from the network first, so it always matches the core.js
+    that was just loaded, and keep a copy in the Cache API. The cached copy
+    is only used when the network is unavailable.
+*/
+async function fetchWasm() {
+    const cache = 'caches' in window ? await caches.open(WASM_CACHE) : null;
+    try {
+        const res = await fetch(WASM_URL);
+        if (!res.ok) throw new Error(`${WASM_URL}: HTTP ${res.status}`);
+        if (cache) cache.put(WASM_URL, res.clone());
+        return res;
+    } catch (err) {
+        const cached = cache && await cache.match(WASM_URL);
+        if (cached) return cached;
+        throw err;
+    }
+}
+
+function reportError(message) {
+    console.error(message);
+    document.getElementById("status").textContent = message;
+}
+
+// Compile core.wasm while it downloads, falling back to a plain
+// compile when the server doesn't send the application/wasm type
+function instantiateWasm(imports, receiveInstance) {
+    fetchWasm()
+        .then((res) => WebAssembly.instantiateStreaming(res.clone(), imports)
+            .catch(() => res.arrayBuffer()
+                .then((bytes) => WebAssembly.instantiate(bytes, imports))))
+        .then((result) => receiveInstance(result.instance, result.module))
+        .catch((err) => reportError(`Unable to load the emulator: ${err}`));
+    return {};
+}
+
+createModule({ instantiateWasm }).then((Module) => {
     const init = Module.cwrap('chip8_init_emscripten', 'void', []);
     const cycle = Module.cwrap('chip8_cycle_emscripten', 'void', []);
     const load_program = Module.cwrap('chip8_load_rom_emscripten', 'void', ['number', 'number']);
+    const loadBundled = Module.cwrap('chip8_load_bundled_rom_emscripten', 'number', ['string']);
     const pressKey = Module.cwrap('chip8_key_press_emscripten', 'void', ['number']);
     const releaseKey = Module.cwrap('chip8_key_release_emscripten', 'void', ['number']);
     const getDisplayPtr = Module.cwrap('chip8_get_display_emscripten', 'number', []);
@@ -13,6 +53,14 @@ createModule().then((Module) => {
     const isDisplayUpdated = Module.cwrap('chip8_is_display_updated_emscripten', 'number', []);
     const isHires = Module.cwrap('chip8_is_hires_emscripten', 'number', []);
     const setMode = Module.cwrap('chip8_set_mode_emscripten', 'void', ['number']);
+    // Colour for each display value, XO-CHIP uses bits 0-3 as plane flags
+    const palette = [
+        "#000000", "#FFFFFF", "#AAAAAA", "#555555",
+        "#FF0000", "#00FF00", "#0000FF", "#FFFF00",
+        "#880000", "#008800", "#000088", "#888800",
+        "#FF00FF", "#00FFFF", "#880088", "#008888"
+    ];
+    let mode = 0;
     let hires = 0;
     let opsPerFrame = 10;
     init();
@@ -34,10 +82,10 @@ createModule().then((Module) => {
         }
         if (forceRedraw) {
             ctx.clearRect(0, 0, canvas.width, canvas.height);
-            ctx.fillStyle = "#FFFFFF";
             for (let y = 0; y < height; y++) {
                 for (let x = 0; x < width; x++) {
                     if (display[y * width + x]) {
+                        ctx.fillStyle = palette[display[y * width + x]];
                         ctx.fillRect(x * scale, y * scale, scale, scale);
                     }
                 }
@@ -52,7 +100,7 @@ createModule().then((Module) => {
                 const current = display[i];
                 const previous = prevDisplay[i];
                 if (current !== previous) {
-                    ctx.fillStyle = current ? "#FFFFFF" : "#000000";
+                    ctx.fillStyle = palette[current];
                     ctx.fillRect(x * scale, y * scale, scale, scale);
                     prevDisplay[i] = current;
                 }
@@ -125,30 +173,33 @@ createModule().then((Module) => {
         pauseChip();
     });
 
+    // ROMs in roms/ are compiled into the module, so selecting one
+    // loads it in place without a fetch or a heap copy
     document.getElementById("romSelect").onchange = (e) => {
-        const url = e.target.value;
-        if (!url) return;
-
-        fetch(url)
-            .then(res => res.arrayBuffer())
-            .then(buffer => {
-                const bytes = new Uint8Array(buffer);
-                const buf = Module._malloc(bytes.length);
-                Module.HEAPU8.set(bytes, buf);
-                load_program(buf, bytes.length);
-                startEmulation();
-            });
+        const name = e.target.value;
+        if (!name) return;
+        if (loadBundled(name)) startEmulation();
     };
 
     document.getElementById('opsSlider').addEventListener('input', (e) => {
         opsPerFrame = parseInt(e.target.value, 10);
     });
 
+    const applyMode = (newMode) => {
+        mode = newMode;
+        setMode(mode);
+        updateCanvasSize();
+        drawDisplay(1);
+    };
+
     document.getElementById('schipToggle').addEventListener('change', (e) => {
-        const enabled = e.target.checked ? 1 : 0;
-        setMode(enabled);
-        updateCanvasSize();     
-        drawDisplay(1);         
+        if (e.target.checked) document.getElementById('xochipToggle').checked = false;
+        applyMode(e.target.checked ? 1 : 0);
+    });
+
+    document.getElementById('xochipToggle').addEventListener('change', (e) => {
+        if (e.target.checked) document.getElementById('schipToggle').checked = false;
+        applyMode(e.target.checked ? 2 : 0);
     });
 
 });
\ No newline at end of file
@@ -0,0 +1,226 @@
+#include "netplay.h"
+#include "chip8.h"
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define SNAPSHOTS (NETPLAY_MAX_ROLLBACK + 1)
+#define NO_FRAME 0xFFFFFFFF
+
+static struct {
+    int socket;
+    struct sockaddr_storage peer;
+    socklen_t peerLength;
+    int player;
+    int cyclesPerFrame;
+    uint32_t frame;       // next frame to simulate
+    uint32_t confirmed;   // last remote frame received, NO_FRAME if none
+    uint32_t acked;       // last local frame the peer has, NO_FRAME if none
+    uint32_t rollbackTo;  // earliest mispredicted frame, NO_FRAME if none
+    uint16_t input[2][NETPLAY_HISTORY];
+    uint16_t predicted[NETPLAY_HISTORY]; // remote input each frame ran with
+    struct chip8Snapshot *snapshots;
+    struct netplayStats stats;
+} net = {.socket = -1};
+
+static void put32(uint8_t *p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static uint32_t get32(const uint8_t *p) {
+    return (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+// frames are compared as differences so the counter may wrap
+static int frameBefore(uint32_t a, uint32_t b) { return (int32_t)(a - b) < 0; }
+
+static void sendInputs() {
+    uint8_t packet[NETPLAY_PACKET_SIZE];
+    uint32_t first = net.acked + 1; // NO_FRAME + 1 wraps to frame 0
+    uint32_t count = net.frame - first;
+
+    // the oldest inputs go first, the peer can only use them in order
+    if (count > NETPLAY_MAX_INPUTS) count = NETPLAY_MAX_INPUTS;
+    memcpy(packet, NETPLAY_MAGIC, 4);
+    packet[4] = NETPLAY_VERSION;
+    packet[5] = net.player;
+    put32(&packet[6], net.confirmed);
+    put32(&packet[10], first);
+    packet[14] = count;
+    for (uint32_t i = 0; i < count; i++) {
+        int slot = (first + i) & (NETPLAY_HISTORY - 1);
+        uint16_t keys = net.input[net.player][slot];
+        packet[15 + i * 2] = keys >> 8;
+        packet[16 + i * 2] = keys;
+    }
+    sendto(net.socket, packet, 15 + count * 2, 0,
+           (struct sockaddr *)&net.peer, net.peerLength);
+}
+
+static void receiveInput(uint32_t frame, uint16_t keys) {
+    int remote = !net.player;
+    int slot = frame & (NETPLAY_HISTORY - 1);
+
+    net.input[remote][slot] = keys;
+    net.confirmed = frame;
+    // a frame that already ran with a wrong guess has to be replayed
+    if (frameBefore(frame, net.frame) && net.predicted[slot] != keys
+        && (net.rollbackTo == NO_FRAME || frameBefore(frame, net.rollbackTo)))
+        net.rollbackTo = frame;
+}
+
+static void receivePackets() {
+    uint8_t packet[NETPLAY_PACKET_SIZE];
+    ssize_t length;
+
+    while ((length = recv(net.socket, packet, sizeof(packet), 0)) > 0) {
+        if (length < 15 || memcmp(packet, NETPLAY_MAGIC, 4) != 0
+            || packet[4] != NETPLAY_VERSION || packet[5] == net.player)
+            continue;
+        uint32_t ack = get32(&packet[6]);
+        uint32_t first = get32(&packet[10]);
+        int count = packet[14];
+        if (length < 15 + count * 2) continue;
+
+        // an ack for a frame not sent yet is left over from another session
+        if (ack != NO_FRAME && frameBefore(ack, net.frame)
+            && (net.acked == NO_FRAME || frameBefore(net.acked, ack)))
+            net.acked = ack;
+        for (int i = 0; i < count; i++) {
+            uint32_t frame = first + i;
+            // inputs must arrive in order, older ones are already known
+            if (frame != net.confirmed + 1) continue;
+            receiveInput(frame, packet[15 + i * 2] << 8 | packet[16 + i * 2]);
+        }
+    }
+}
+
+static void simulateFrame(uint32_t frame) {
+    int slot = frame & (NETPLAY_HISTORY - 1);
+    int remote = !net.player;
+    uint16_t remoteKeys;
+
+    saveState(&net.snapshots[frame % SNAPSHOTS]);
+    if (net.confirmed != NO_FRAME && !frameBefore(net.confirmed, frame))
+        remoteKeys = net.input[remote][slot];
+    else if (net.confirmed != NO_FRAME)
+        remoteKeys = net.input[remote][net.confirmed & (NETPLAY_HISTORY - 1)];
+    else
+        remoteKeys = 0;
+    net.predicted[slot] = remoteKeys;
+
+    uint16_t keys = net.input[net.player][slot] | remoteKeys;
+    for (int i = 0; i < NUM_KEYS; i++) {
+        chip8.key[i] = (keys >> i) & 1;
+    }
+    for (int i = 0; i < net.cyclesPerFrame; i++) {
+        chip8Cycle();
+    }
+    chip8Tick();
+}
+
+static void rollback() {
+    uint32_t from = net.rollbackTo;
+    int frames = net.frame - from;
+
+    net.rollbackTo = NO_FRAME;
+    loadState(&net.snapshots[from % SNAPSHOTS]);
+    for (uint32_t frame = from; frame != net.frame; frame++) {
+        simulateFrame(frame);
+    }
+    net.stats.rollbacks++;
+    net.stats.resimulated += frames;
+    if (frames > net.stats.maxRollback) net.stats.maxRollback = frames;
+}
+
+int netplayStart(int player, int localPort, const char *host, int port,
+                 int cyclesPerFrame) {
+    struct addrinfo hints = {0}, *address;
+    struct sockaddr_in local = {0};
+    char service[16];
+
+    netplayStop();
+    net.snapshots = malloc(SNAPSHOTS * sizeof(struct chip8Snapshot));
+    if (!net.snapshots) {
+        fprintf(stderr, "Unable to allocate netplay snapshots\n");
+        return 0;
+    }
+
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    snprintf(service, sizeof(service), "%d", port);
+    if (getaddrinfo(host, service, &hints, &address) != 0) {
+        fprintf(stderr, "Unable to resolve %s\n", host);
+        netplayStop();
+        return 0;
+    }
+    memcpy(&net.peer, address->ai_addr, address->ai_addrlen);
+    net.peerLength = address->ai_addrlen;
+    freeaddrinfo(address);
+
+    net.socket = socket(AF_INET, SOCK_DGRAM, 0);
+    local.sin_family = AF_INET;
+    local.sin_port = htons(localPort);
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (net.socket < 0
+        || bind(net.socket, (struct sockaddr *)&local, sizeof(local)) < 0) {
+        perror("netplay socket");
+        netplayStop();
+        return 0;
+    }
+    fcntl(net.socket, F_SETFL, fcntl(net.socket, F_GETFL) | O_NONBLOCK);
+
+    net.player = player ? 1 : 0;
+    net.cyclesPerFrame = cyclesPerFrame;
+    net.frame = 0;
+    net.confirmed = NO_FRAME;
+    net.acked = NO_FRAME;
+    net.rollbackTo = NO_FRAME;
+    memset(net.input, 0, sizeof(net.input));
+    memset(&net.stats, 0, sizeof(net.stats));
+
+    reload();
+    chip8Seed(NETPLAY_SEED);
+    return 1;
+}
+
+int netplayFrame(uint16_t localKeys) {
+    if (net.socket < 0) return 0;
+    receivePackets();
+
+    // don't run further ahead than a rollback can repair, the remote
+    // may also be ahead of us, so the difference is signed
+    uint32_t known = net.confirmed + 1; // NO_FRAME + 1 wraps to 0
+    if ((int32_t)(net.frame - known) >= NETPLAY_MAX_ROLLBACK) {
+        sendInputs();
+        net.stats.stalls++;
+        return 0;
+    }
+    if (net.rollbackTo != NO_FRAME) rollback();
+
+    net.input[net.player][net.frame & (NETPLAY_HISTORY - 1)] = localKeys;
+    simulateFrame(net.frame);
+    net.frame++;
+    net.stats.frames++;
+    sendInputs();
+    return 1;
+}
+
+uint32_t netplayCurrentFrame() { return net.frame; }
+
+const struct netplayStats *netplayGetStats() { return &net.stats; }
+
+void netplayStop() {
+    if (net.socket >= 0) close(net.socket);
+    net.socket = -1;
+    free(net.snapshots);
+    net.snapshots = NULL;
+}
@@ -0,0 +1,66 @@
+/*
+    Rollback netplay
+    Two peers run the same ROM in lockstep, each pressing keys on the shared
+    keypad. Every frame the local keys are sent to the other peer over UDP,
+    usually through relay.c, and the remote keys for frames that haven't
+    arrived yet are predicted by repeating the last ones received. When a
+    prediction turns out wrong the emulator restores the snapshot taken
+    before that frame and re-simulates up to the present with the real
+    input, all within one call to netplayFrame().
+
+    Both peers must load the same ROM and mode before calling
+    netplayStart(), which restarts the ROM with a shared random seed.
+
+    Packet format (all multi-byte values are big-endian):
+        "C8NP" version(1) player(1)
+        ack(4):   last frame of the receiver's input the sender has
+        first(4): frame of the first input in this packet
+        count(1), then count 16-bit keypad masks, bit N set for key N
+*/
+
+#ifndef CHIP8_NETPLAY_H
+#define CHIP8_NETPLAY_H
+
+#include <stdint.h>
+
+#define NETPLAY_PORT 7800
+#define NETPLAY_MAGIC "C8NP"
+#define NETPLAY_VERSION 1
+#define NETPLAY_SEED 0xC8C8C8C8
+#define NETPLAY_MAX_ROLLBACK 16 // frames that can be re-simulated
+#define NETPLAY_HISTORY 128     // input frames kept, must be a power of 2
+#define NETPLAY_MAX_INPUTS 64   // inputs sent in one packet
+#define NETPLAY_PACKET_SIZE (15 + NETPLAY_MAX_INPUTS * 2)
+
+struct netplayStats {
+    long frames;        // frames simulated for the first time
+    long rollbacks;     // mispredictions corrected
+    long resimulated;   // frames simulated again during rollbacks
+    int maxRollback;    // most frames re-simulated by one rollback
+    long stalls;        // calls that waited for the remote peer
+};
+
+/*
+    Start a netplay session
+    player is 0 or 1, localPort may be 0 to pick any free port, and
+    host:port is the relay or the other peer.
+    returns 1 on success, 0 on failure
+*/
+int netplayStart(int player, int localPort, const char *host, int port,
+                 int cyclesPerFrame);
+
+/*
+    Run one frame with the given local keypad mask
+    Call this once per host frame instead of chip8Cycle/chip8Tick.
+    returns 1 if a frame was run, 0 if waiting for the remote peer
+*/
+int netplayFrame(uint16_t localKeys);
+
+// current frame number, the next frame to be run
+uint32_t netplayCurrentFrame();
+
+const struct netplayStats *netplayGetStats();
+
+void netplayStop();
+
+#endif
@@ -1,5 +1,6 @@
 #include "opcode.h"
 #include "chip8.h"
+#include "debugger.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -7,14 +8,47 @@
 #include <unistd.h>
 
 void code0(uint16_t opcode);
+void code5(uint8_t subcode, uint8_t X, uint8_t Y);
 void code8(uint8_t subcode, uint8_t X, uint8_t Y);
 void codeD(uint16_t opcode, uint8_t X, uint8_t Y);
 void codeE(uint16_t NN, uint8_t X);
 void codeF(uint16_t opcode, uint8_t X);
+void xoClear();
+void xoScrollDown(int n);
+void xoScrollUp(int n);
+void xoScrollRight();
+void xoScrollLeft();
+void xoDraw(uint16_t opcode, uint8_t X, uint8_t Y);
 
 int temp = 0;
 int nn = 0;
-int kp = -1;
+
+/*
+    Report an opcode the current mode doesn't implement and pause
+    The program counter has already moved past it
+*/
+static void unknownOpcode(uint16_t opcode) {
+    uint16_t address = chip8.programCounter - 2;
+    fprintf(stderr, "Unknown opcode 0x%04x at 0x%x\n\n", opcode, address);
+#ifdef CHIP8_NO_DEBUGGER
+    chip8.isPaused = 1;
+#else
+    debugStop(DEBUG_STOP_UNKNOWN_OPCODE, address);
+#endif
+}
+
+/*
+    Skip the next instruction
+    In XO-CHIP mode F000 NNNN is four bytes long and is skipped as a whole
+*/
+static inline void skipNext() {
+    if (chip8.xochip && chip8.memory[MEM_WRAP(chip8.programCounter)] == 0xF0
+        && chip8.memory[MEM_WRAP(chip8.programCounter + 1)] == 0x00)
+        chip8.programCounter += 4;
+    else
+        chip8.programCounter += 2;
+}
+
 /*
     Main opcode decoder
     This function decodes the opcode and calls the appropriate function
@@ -37,19 +71,23 @@ void chip8_decode_and_execute(uint16_t opcode) {
         chip8.programCounter = NNN;
         break;
     case 0x3:
-        if (chip8.registers[X] == NN) chip8.programCounter += 2;
+        if (chip8.registers[X] == NN) skipNext();
         break;
     case 0x4:
-        if (chip8.registers[X] != NN) chip8.programCounter += 2;
+        if (chip8.registers[X] != NN) skipNext();
         break;
     case 0x5:
-        if (chip8.registers[X] == chip8.registers[Y]) chip8.programCounter += 2;
+        if (chip8.xochip && subcode) {
+            code5(subcode, X, Y);
+            break;
+        }
+        if (chip8.registers[X] == chip8.registers[Y]) skipNext();
         break;
     case 0x6: chip8.registers[X] = NN; break;
     case 0x7: chip8.registers[X] += NN; break;
     case 0x8: code8(subcode, X, Y); break;
     case 0x9:
-        if (chip8.registers[X] != chip8.registers[Y]) chip8.programCounter += 2;
+        if (chip8.registers[X] != chip8.registers[Y]) skipNext();
         break;
     case 0xA: chip8.indexRegister = NNN; break;
     case 0xB:
@@ -57,12 +95,15 @@ void chip8_decode_and_execute(uint16_t opcode) {
             = NNN + (chip8.jumpx ? chip8.registers[X] : chip8.registers[0]);
         break;
     case 0xC:
-        chip8.registers[X] = (rand() % 256) & NN; // Apply mask
+        chip8.registers[X] = chip8Random() & NN; // Apply mask
+        break;
+    case 0xD:
+        if (chip8.xochip) xoDraw(opcode, X, Y);
+        else codeD(opcode, X, Y);
         break;
-    case 0xD: codeD(opcode, X, Y); break;
     case 0xE: codeE(NN, X); break;
     case 0xF: codeF(opcode, X); break;
-    default: printf("Unknown opcode main 0x%x\n\n", opcode); chip8.isPaused = 1;
+    default: unknownOpcode(opcode);
     }
 }
 
@@ -72,6 +113,10 @@ void code0(uint16_t opcode) {
 
     switch (opcode & 0x00FF) {
     case 0xE0: // Clear the display
+        if (chip8.xochip) {
+            xoClear();
+            break;
+        }
         memset(chip8.display, 0, DISPLAY_WIDTH * DISPLAY_HEIGHT);
         chip8.displayUpdate = 1;
         break;
@@ -80,6 +125,10 @@ void code0(uint16_t opcode) {
         chip8.sp--;
         break;
     case 0xFB:
+        if (chip8.xochip) {
+            xoScrollRight();
+            break;
+        }
         width = chip8.hires ? 128 : 64;
         height = chip8.hires ? 64 : 32;
         for (int y = 0; y < height; y++) {
@@ -95,6 +144,10 @@ void code0(uint16_t opcode) {
         chip8.displayUpdate = 1;
         break;
     case 0xFC:
+        if (chip8.xochip) {
+            xoScrollLeft();
+            break;
+        }
         width = chip8.hires ? 128 : 64;
         height = chip8.hires ? 64 : 32;
         for (int y = 0; y < height; y++) {
@@ -114,13 +167,25 @@ void code0(uint16_t opcode) {
         break;
     case 0xFE:  //Set to low-res mode
         chip8.hires = 0;
+        if (chip8.xochip) memset(chip8.planes, 0, sizeof(chip8.planes));
+        chip8.planesDirty = chip8.xochip;
         chip8.displayUpdate = 1;
         break;
     case 0xFF: // Set to high-res mode
         chip8.hires = 1;
+        if (chip8.xochip) memset(chip8.planes, 0, sizeof(chip8.planes));
+        chip8.planesDirty = chip8.xochip;
         chip8.displayUpdate = 1;
         break;
     default:
+        if (chip8.xochip && (opcode & 0xFFF0) == 0x00C0) {
+            xoScrollDown(opcode & 0x000F);
+            break;
+        }
+        if (chip8.xochip && (opcode & 0xFFF0) == 0x00D0) {
+            xoScrollUp(opcode & 0x000F);
+            break;
+        }
         if ((opcode & 0xF000) == 0x0000 && (opcode & 0xF0F0) == 0x00C0) {
             int width = chip8.hires ? 128 : 64;
             int height = chip8.hires ? 64 : 32;
@@ -139,11 +204,40 @@ void code0(uint16_t opcode) {
             chip8.displayUpdate = 1;
         }
         break;
-        printf("Unknown opcode in 0x0 0x%x\n\n", opcode);
+        fprintf(stderr, "Unknown opcode in 0x0 0x%x\n\n", opcode);
         chip8.isPaused = 1;
     }
 }
 
+/*
+    XO-CHIP register range save and load
+    5XY2 stores VX..VY at I, 5XY3 loads them, in either order.
+    I is left unchanged
+*/
+void code5(uint8_t subcode, uint8_t X, uint8_t Y) {
+    int step = X <= Y ? 1 : -1;
+    int count = (X <= Y ? Y - X : X - Y) + 1;
+    switch (subcode) {
+    case 0x2:
+        DEBUG_MEMORY_ACCESS(MEM_WRAP(chip8.indexRegister), count,
+                            DEBUG_WATCH_WRITE);
+        for (int i = 0; i < count; i++) {
+            chip8.memory[MEM_WRAP(chip8.indexRegister + i)]
+                = chip8.registers[X + i * step];
+        }
+        break;
+    case 0x3:
+        DEBUG_MEMORY_ACCESS(MEM_WRAP(chip8.indexRegister), count,
+                            DEBUG_WATCH_READ);
+        for (int i = 0; i < count; i++) {
+            chip8.registers[X + i * step]
+                = chip8.memory[MEM_WRAP(chip8.indexRegister + i)];
+        }
+        break;
+    default: unknownOpcode(0x5000 | X << 8 | Y << 4 | subcode);
+    }
+}
+
 void code8(uint8_t subcode, uint8_t X, uint8_t Y) {
     uint16_t sum = 0;
     switch (subcode) {
@@ -193,30 +287,66 @@ void code8(uint8_t subcode, uint8_t X, uint8_t Y) {
 void codeE(uint16_t NN, uint8_t X) {
     switch (NN) {
     case 0x9E:
-        if (chip8.key[chip8.registers[X]] == 1) chip8.programCounter += 2;
+        if (chip8.key[chip8.registers[X]] == 1) skipNext();
         break;
     case 0xA1:
-        if (chip8.key[chip8.registers[X]] == 0) chip8.programCounter += 2;
+        if (chip8.key[chip8.registers[X]] == 0) skipNext();
         break;
-    default: printf("Unknown opcode in E 0x%x\n\n", NN); chip8.isPaused = 1;
+    default: unknownOpcode(0xE000 | X << 8 | NN);
     }
 }
 
 void codeF(uint16_t opcode, uint8_t X) {
     uint8_t value = 0;
     switch (opcode & 0x00FF) {
+    case 0x00:
+        if (chip8.xochip && X == 0) { // F000 NNNN: I = NNNN
+            chip8.indexRegister
+                = chip8.memory[MEM_WRAP(chip8.programCounter)] << 8
+                  | chip8.memory[MEM_WRAP(chip8.programCounter + 1)];
+            chip8.programCounter += 2;
+            break;
+        }
+        unknownOpcode(opcode);
+        break;
+    case 0x01:
+        if (chip8.xochip) { // FN01: select drawing planes
+            chip8.planeMask = X;
+            break;
+        }
+        unknownOpcode(opcode);
+        break;
+    case 0x02:
+        if (chip8.xochip && X == 0) { // F002: load audio pattern from I
+            DEBUG_MEMORY_ACCESS(MEM_WRAP(chip8.indexRegister), XO_AUDIO_SIZE,
+                                DEBUG_WATCH_READ);
+            for (int i = 0; i < XO_AUDIO_SIZE; i++) {
+                chip8.audioPattern[i]
+                    = chip8.memory[MEM_WRAP(chip8.indexRegister + i)];
+            }
+            break;
+        }
+        unknownOpcode(opcode);
+        break;
+    case 0x3A:
+        if (chip8.xochip) { // FX3A: set audio pitch
+            chip8.pitch = chip8.registers[X];
+            break;
+        }
+        unknownOpcode(opcode);
+        break;
     case 0x07: chip8.registers[X] = chip8.delayTimer; break;
     case 0x0A:
         for (int i = 0; i < 16; i++) {
-            if (kp != -1) {
-                if (chip8.key[kp] != 1) {
+            if (chip8.heldKey != -1) {
+                if (chip8.key[chip8.heldKey] != 1) {
                     nn = 1;
-                    kp = -1;
+                    chip8.heldKey = -1;
                 }
                 break;
             }
             if (chip8.key[i] == 1) {
-                kp = i;
+                chip8.heldKey = i;
                 chip8.registers[X] = i;
                 break;
             }
@@ -232,23 +362,31 @@ void codeF(uint16_t opcode, uint8_t X) {
     case 0x29: chip8.indexRegister = 0x050 + (chip8.registers[X] * 5); break;
     case 0x33:
         value = chip8.registers[X];
-        chip8.memory[chip8.indexRegister] = value / 100;
-        chip8.memory[chip8.indexRegister + 1] = (value / 10) % 10;
-        chip8.memory[chip8.indexRegister + 2] = value % 10;
+        DEBUG_MEMORY_ACCESS(MEM_WRAP(chip8.indexRegister), 3,
+                            DEBUG_WATCH_WRITE);
+        chip8.memory[MEM_WRAP(chip8.indexRegister)] = value / 100;
+        chip8.memory[MEM_WRAP(chip8.indexRegister + 1)] = (value / 10) % 10;
+        chip8.memory[MEM_WRAP(chip8.indexRegister + 2)] = value % 10;
         break;
     case 0x55:
+        DEBUG_MEMORY_ACCESS(MEM_WRAP(chip8.indexRegister), X + 1,
+                            DEBUG_WATCH_WRITE);
         for (int i = 0; i <= X; i++) {
-            chip8.memory[chip8.indexRegister + i] = chip8.registers[i];
+            chip8.memory[MEM_WRAP(chip8.indexRegister + i)]
+                = chip8.registers[i];
         }
         if (chip8.memoryInc) chip8.indexRegister += X + 1;
         break;
     case 0x65:
+        DEBUG_MEMORY_ACCESS(MEM_WRAP(chip8.indexRegister), X + 1,
+                            DEBUG_WATCH_READ);
         for (int i = 0; i <= X; i++) {
-            chip8.registers[i] = chip8.memory[chip8.indexRegister + i];
+            chip8.registers[i]
+                = chip8.memory[MEM_WRAP(chip8.indexRegister + i)];
         }
         if (chip8.memoryInc) chip8.indexRegister += X + 1;
         break;
-    default: printf("Unknown opcode in F 0x%x\n\n", opcode); chip8.isPaused = 1;
+    default: unknownOpcode(opcode);
     }
 }
 
@@ -268,16 +406,19 @@ void codeD(uint16_t opcode, uint8_t X, uint8_t Y) {
         height = 16;
         width = 16;
     }
+    DEBUG_MEMORY_ACCESS(MEM_WRAP(chip8.indexRegister), height * width / 8,
+                        DEBUG_WATCH_READ);
 
     for (int row = 0; row < height; row++) {
         if (y + row >= screenHeight) break; // Prevent drawing outside screen
         uint16_t spriteRow;
 
         if (width == 8) {
-            spriteRow = chip8.memory[chip8.indexRegister + row];
+            spriteRow = chip8.memory[MEM_WRAP(chip8.indexRegister + row)];
         } else {
-            spriteRow = (chip8.memory[chip8.indexRegister + row * 2] << 8)
-                        | chip8.memory[chip8.indexRegister + row * 2 + 1];
+            spriteRow
+                = (chip8.memory[MEM_WRAP(chip8.indexRegister + row * 2)] << 8)
+                  | chip8.memory[MEM_WRAP(chip8.indexRegister + row * 2 + 1)];
         }
 
         for (int col = 0; col < width; col++) {
@@ -294,3 +435,159 @@ void codeD(uint16_t opcode, uint8_t X, uint8_t Y) {
     }
     chip8.displayUpdate = 1;
 }
+
+/*
+    XO-CHIP display
+    Each plane row is DISPLAY_WORDS 64-bit words with column 0 in the MSB of
+    word 0, so scrolling and sprite drawing work on whole words. In low-res
+    mode only word 0 and the first 32 rows are used. Only the planes selected
+    by FN01 are affected.
+*/
+void xoClear() {
+    for (int p = 0; p < XO_PLANES; p++) {
+        if (chip8.planeMask & (1 << p))
+            memset(chip8.planes[p], 0, sizeof(chip8.planes[p]));
+    }
+    chip8.planesDirty = 1;
+    chip8.displayUpdate = 1;
+}
+
+void xoScrollDown(int n) {
+    int height = chip8.hires ? 64 : 32;
+    if (n > height) n = height;
+    for (int p = 0; p < XO_PLANES; p++) {
+        if (!(chip8.planeMask & (1 << p))) continue;
+        memmove(chip8.planes[p][n], chip8.planes[p][0],
+                (height - n) * sizeof(chip8.planes[p][0]));
+        memset(chip8.planes[p][0], 0, n * sizeof(chip8.planes[p][0]));
+    }
+    chip8.planesDirty = 1;
+    chip8.displayUpdate = 1;
+}
+
+void xoScrollUp(int n) {
+    int height = chip8.hires ? 64 : 32;
+    if (n > height) n = height;
+    for (int p = 0; p < XO_PLANES; p++) {
+        if (!(chip8.planeMask & (1 << p))) continue;
+        memmove(chip8.planes[p][0], chip8.planes[p][n],
+                (height - n) * sizeof(chip8.planes[p][0]));
+        memset(chip8.planes[p][height - n], 0, n * sizeof(chip8.planes[p][0]));
+    }
+    chip8.planesDirty = 1;
+    chip8.displayUpdate = 1;
+}
+
+void xoScrollRight() {
+    int height = chip8.hires ? 64 : 32;
+    for (int p = 0; p < XO_PLANES; p++) {
+        if (!(chip8.planeMask & (1 << p))) continue;
+        for (int y = 0; y < height; y++) {
+            uint64_t *row = chip8.planes[p][y];
+            if (chip8.hires) row[1] = row[1] >> 4 | row[0] << 60;
+            row[0] >>= 4;
+        }
+    }
+    chip8.planesDirty = 1;
+    chip8.displayUpdate = 1;
+}
+
+void xoScrollLeft() {
+    int height = chip8.hires ? 64 : 32;
+    for (int p = 0; p < XO_PLANES; p++) {
+        if (!(chip8.planeMask & (1 << p))) continue;
+        for (int y = 0; y < height; y++) {
+            uint64_t *row = chip8.planes[p][y];
+            if (chip8.hires) {
+                row[0] = row[0] << 4 | row[1] >> 60;
+                row[1] <<= 4;
+            } else {
+                row[0] <<= 4;
+            }
+        }
+    }
+    chip8.planesDirty = 1;
+    chip8.displayUpdate = 1;
+}
+
+/*
+    Build the row mask for a sprite row of `width` bits placed at column x,
+    wrapping around the right edge of the screen
+*/
+static void xoRowMask(uint16_t bits, int width, int x, uint64_t mask[2]) {
+    uint64_t hi = (uint64_t)bits << (64 - width);
+    uint64_t lo = 0;
+    if (!chip8.hires) {
+        // low-res rows are a single word, so a rotate wraps at 64
+        mask[0] = x ? (hi >> x | hi << (64 - x)) : hi;
+        mask[1] = 0;
+        return;
+    }
+    if (x >= 64) {
+        lo = hi;
+        hi = 0;
+        x -= 64;
+    }
+    if (x) {
+        uint64_t h = hi >> x | lo << (64 - x);
+        lo = lo >> x | hi << (64 - x);
+        hi = h;
+    }
+    mask[0] = hi;
+    mask[1] = lo;
+}
+
+/*
+    XO-CHIP DXYN
+    Draws to every selected plane, the sprite data for each plane following
+    the previous one in memory. Sprites wrap around the screen edges
+*/
+void xoDraw(uint16_t opcode, uint8_t X, uint8_t Y) {
+    int height = opcode & 0x000F;
+    int screenWidth = chip8.hires ? 128 : 64;
+    int screenHeight = chip8.hires ? 64 : 32;
+    int x = chip8.registers[X] % screenWidth;
+    int y = chip8.registers[Y] % screenHeight;
+    int width = 8;
+    uint16_t addr = chip8.indexRegister;
+
+    chip8.registers[0xF] = 0;
+
+    if (height == 0) {
+        height = 16;
+        width = 16;
+    }
+    if (chip8.planeMask) {
+        int planes = 0;
+        for (int p = 0; p < XO_PLANES; p++) {
+            planes += (chip8.planeMask >> p) & 1;
+        }
+        DEBUG_MEMORY_ACCESS(MEM_WRAP(chip8.indexRegister),
+                            planes * height * width / 8, DEBUG_WATCH_READ);
+    }
+
+    for (int p = 0; p < XO_PLANES; p++) {
+        if (!(chip8.planeMask & (1 << p))) continue;
+        for (int row = 0; row < height; row++) {
+            uint16_t spriteRow;
+            if (width == 8) {
+                spriteRow = chip8.memory[MEM_WRAP(addr++)];
+            } else {
+                spriteRow = chip8.memory[MEM_WRAP(addr)] << 8
+                            | chip8.memory[MEM_WRAP(addr + 1)];
+                addr += 2;
+            }
+            if (!spriteRow) continue;
+
+            uint64_t mask[2];
+            xoRowMask(spriteRow, width, x, mask);
+            uint64_t *line = chip8.planes[p][(y + row) % screenHeight];
+            if ((line[0] & mask[0]) | (line[1] & mask[1]))
+                chip8.registers[0xF] = 1;
+            line[0] ^= mask[0];
+            line[1] ^= mask[1];
+        }
+    }
+    chip8.planesDirty = 1;
+    chip8.displayUpdate = 1;
+}
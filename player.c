@@ -0,0 +1,136 @@
+/*
+    player.c
+    Decoder and terminal player for recordings made by recorder.c.
+    See recorder.h for the stream format.
+
+    Usage: player recording.c8r [fps]
+    An fps of 0 decodes the whole stream as fast as possible and prints
+    the last frame and a summary, which is handy for checking test runs.
+*/
+
+#include "recorder.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+struct stream {
+    FILE *in;
+    uint32_t ticks; // ticks since the previous frame
+    int hires;
+    int planes;
+    uint8_t flags;
+    uint8_t frame[RECORDER_FRAME_SIZE];
+    uint8_t encoded[RECORDER_FRAME_SIZE + RECORDER_FRAME_SIZE / 128 + 1];
+};
+
+static int readVarint(FILE *in, uint32_t *value) {
+    *value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        int c = fgetc(in);
+        if (c == EOF) return 0;
+        *value |= (uint32_t)(c & 0x7F) << shift;
+        if (!(c & 0x80)) return 1;
+    }
+    return 0;
+}
+
+// Read the next frame and apply it to s->frame
+// returns 1 on success, 0 at the end of the stream or on a corrupt frame
+static int nextFrame(struct stream *s) {
+    uint32_t length;
+    int flags;
+    if (!readVarint(s->in, &s->ticks)) return 0;
+    if ((flags = fgetc(s->in)) == EOF) return 0;
+    if (!readVarint(s->in, &length) || length > sizeof(s->encoded)) return 0;
+    if (fread(s->encoded, 1, length, s->in) != length) return 0;
+
+    if (flags != s->flags) {
+        memset(s->frame, 0, sizeof(s->frame));
+        s->flags = flags;
+    }
+    s->hires = flags & 1;
+    s->planes = ((flags >> 1) & 3) + 1;
+    int size = s->planes * (s->hires ? 128 * 64 : 64 * 32) / 8;
+
+    uint8_t *in = s->encoded;
+    uint8_t *end = s->encoded + length;
+    int pos = 0;
+    while (in < end) {
+        int control = *in++;
+        int count = (control & 0x7F) + 1;
+        if (pos + count > size) return 0;
+        if (control & 0x80) {
+            pos += count; // zero run leaves the pixels unchanged
+            continue;
+        }
+        if (in + count > end) return 0;
+        for (int i = 0; i < count; i++) s->frame[pos + i] ^= in[i];
+        in += count;
+        pos += count;
+    }
+    return 1;
+}
+
+static void drawFrame(struct stream *s) {
+    static const char colors[] = " #23456789ABCDEF";
+    int width = s->hires ? 128 : 64;
+    int height = s->hires ? 64 : 32;
+    int planeSize = width * height / 8;
+
+    printf("\033[H");
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int bit = y * width + x;
+            int color = 0;
+            for (int p = 0; p < s->planes; p++) {
+                uint8_t byte = s->frame[p * planeSize + bit / 8];
+                color |= ((byte >> (7 - bit % 8)) & 1) << p;
+            }
+            putchar(colors[color]);
+        }
+        putchar('\n');
+    }
+}
+
+int main(int argc, char **argv) {
+    static struct stream s;
+    char magic[5] = {0};
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s recording.c8r [fps]\n", argv[0]);
+        return 1;
+    }
+    int fps = argc > 2 ? atoi(argv[2]) : 60;
+
+    s.in = strcmp(argv[1], "-") == 0 ? stdin : fopen(argv[1], "rb");
+    if (!s.in) {
+        perror(argv[1]);
+        return 1;
+    }
+    if (fread(magic, 1, 4, s.in) != 4 || strcmp(magic, RECORDER_MAGIC) != 0
+        || fgetc(s.in) != RECORDER_VERSION) {
+        fprintf(stderr, "%s is not a chip8 recording\n", argv[1]);
+        return 1;
+    }
+
+    long frames = 0;
+    long ticks = 0;
+    s.flags = 0xFF;
+    if (fps) printf("\033[2J");
+    while (nextFrame(&s)) {
+        if (fps) {
+            usleep(s.ticks * 1000000L / fps);
+            drawFrame(&s);
+            fflush(stdout);
+        }
+        frames++;
+        ticks += s.ticks;
+    }
+    if (!fps && frames) drawFrame(&s);
+    printf("%ld frames over %ld ticks\n", frames, ticks);
+    if (!feof(s.in)) fprintf(stderr, "recording is truncated or corrupt\n");
+    if (s.in != stdin) fclose(s.in);
+    return 0;
+}
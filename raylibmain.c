@@ -2,24 +2,28 @@
     raylibmain.c
     This file contains the main function for the Chip8 emulator using raylib.
     It initializes the emulator, loads a ROM, and handles input and rendering.
+    Passing a player number and relay address starts a rollback netplay
+    session, see netplay.h.
 */
 
 #include "chip8.h"
+#include "netplay.h"
 #include "raylib.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+struct {
+    int key;
+    uint8_t chip8_key;
+} keymap[] = {
+    {KEY_ONE, 0x1}, {KEY_TWO, 0x2}, {KEY_THREE, 0x3}, {KEY_FOUR, 0xC},
+    {KEY_Q, 0x4},   {KEY_W, 0x5},   {KEY_E, 0x6},     {KEY_R, 0xD},
+    {KEY_A, 0x7},   {KEY_S, 0x8},   {KEY_D, 0x9},     {KEY_F, 0xE},
+    {KEY_Z, 0xA},   {KEY_X, 0x0},   {KEY_C, 0xB},     {KEY_V, 0xF},
+};
 
 void update_keys() {
-    struct {
-        int key;
-        uint8_t chip8_key;
-    } keymap[] = {
-        {KEY_ONE, 0x1}, {KEY_TWO, 0x2}, {KEY_THREE, 0x3}, {KEY_FOUR, 0xC},
-        {KEY_Q, 0x4},   {KEY_W, 0x5},   {KEY_E, 0x6},     {KEY_R, 0xD},
-        {KEY_A, 0x7},   {KEY_S, 0x8},   {KEY_D, 0x9},     {KEY_F, 0xE},
-        {KEY_Z, 0xA},   {KEY_X, 0x0},   {KEY_C, 0xB},     {KEY_V, 0xF},
-    };
-
     int count = sizeof(keymap) / sizeof(keymap[0]);
 
     for (int i = 0; i < count; i++) {
@@ -35,8 +39,19 @@ void update_keys() {
     }
 }
 
+// keypad mask for netplay, bit N set while chip8 key N is held
+uint16_t read_keys() {
+    int count = sizeof(keymap) / sizeof(keymap[0]);
+    uint16_t keys = 0;
+
+    for (int i = 0; i < count; i++) {
+        if (IsKeyDown(keymap[i].key)) keys |= 1 << keymap[i].chip8_key;
+    }
+    return keys;
+}
+
 void loadProgram(char *filename) {
-    uint8_t program[4000];
+    static uint8_t program[XO_MEM_SIZE - 0x200];
     FILE *f = fopen(filename, "rb");
     if (!f) {
         perror("Error opening file");
@@ -47,11 +62,21 @@ void loadProgram(char *filename) {
     long size = ftell(f);
     rewind(f);
 
+    if (size > (long)sizeof(program)) {
+        printf("ROM too large: %ld bytes\n", size);
+        exit(1);
+    }
     fread(&program, 1, size, f);
     loadROM(program, size);
     fclose(f);
 }
 
+// Colour for each display value, XO-CHIP uses bits 0-3 as plane flags
+Color palette[16] = {
+    BLACK,  RAYWHITE, LIGHTGRAY, DARKGRAY, RED,    GREEN,  BLUE,   YELLOW,
+    MAROON, DARKGREEN, DARKBLUE, GOLD,     MAGENTA, SKYBLUE, PURPLE, LIME,
+};
+
 void drawDisplay() {
     uint8_t *display = getDisplay();
     ClearBackground(BLACK);
@@ -62,7 +87,7 @@ void drawDisplay() {
         for (int x = 0; x < width; x++) {
             if (display[y * width + x]) {
                 DrawRectangle(x * pixelSize, y * pixelSize, pixelSize,
-                              pixelSize, RAYWHITE);
+                              pixelSize, palette[display[y * width + x]]);
             }
         }
     }
@@ -75,12 +100,36 @@ int main(int argc, char **argv) {
     const int screenHeight = 500;
     int isPaused = 0;
     int mode = 0;
+    int netplay = 0;
+    char *args[4];
+    int count = 0;
+
+    // --mode may appear anywhere, the rest are positional
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--mode") == 0 && i + 1 < argc) {
+            mode = atoi(argv[++i]);
+        } else if (count < 4) {
+            args[count++] = argv[i];
+        } else {
+            count = 0;
+            break;
+        }
+    }
     chip8Init();
-    if (argc != 2) {
-        printf("Usage: %s program.ch8\n", argv[0]);
+    if (count != 1 && count != 3 && count != 4) {
+        printf("Usage: %s program.ch8 [--mode 0|1|2] "
+               "[player relay-host [port]]\n",
+               argv[0]);
         return 1;
     } else {
-        loadProgram(argv[1]);
+        // set the mode first so XO-CHIP ROMs larger than 4 KB load
+        setMode(mode);
+        loadProgram(args[0]);
+    }
+    if (count >= 3) {
+        int port = count == 4 ? atoi(args[3]) : NETPLAY_PORT;
+        if (!netplayStart(atoi(args[1]), 0, args[2], port, 8)) return 1;
+        netplay = 1;
     }
 
     InitWindow(screenWidth, screenHeight, "chip-8 emulator - JML");
@@ -89,11 +138,15 @@ int main(int argc, char **argv) {
     //--------------------------------------------------------------------------------------
 
     while (!WindowShouldClose()) {
-        update_keys();
-        for (int i = 0; i < 8; i++) {
-            chip8Cycle();
+        if (netplay) {
+            netplayFrame(read_keys());
+        } else {
+            update_keys();
+            for (int i = 0; i < 8; i++) {
+                chip8Cycle();
+            }
+            chip8Tick();
         }
-        chip8Tick();
 
         // Draw
         //----------------------------------------------------------------------------------
@@ -109,36 +162,42 @@ int main(int argc, char **argv) {
         int buttonY = 20;
         int pauseButtonX = GetScreenWidth() - buttonWidth - 130;
         int modeButtonY = 70;
+        // the buttons only change the local machine, so they are
+        // disabled during netplay to keep the peers in sync
+        Color buttonColor = netplay ? LIGHTGRAY : DARKGRAY;
 
         // --- Draw the buttons ---
-        DrawRectangle(buttonX, buttonY, buttonWidth, buttonHeight, DARKGRAY);
+        DrawRectangle(buttonX, buttonY, buttonWidth, buttonHeight,
+                      buttonColor);
         DrawRectangleLines(buttonX, buttonY, buttonWidth, buttonHeight,
                            RAYWHITE);
         DrawText("Reload", buttonX + 15, buttonY + 10, 20, RAYWHITE);
 
         DrawRectangle(pauseButtonX, buttonY, buttonWidth, buttonHeight,
-                      DARKGRAY);
+                      buttonColor);
         DrawRectangleLines(pauseButtonX, buttonY, buttonWidth, buttonHeight,
                            RAYWHITE);
         DrawText(isPaused ? "Start" : "Pause", pauseButtonX + 15, buttonY + 10,
                  20, RAYWHITE);
 
         DrawRectangle(buttonX, modeButtonY, buttonWidth, buttonHeight,
-                      DARKGRAY);
+                      buttonColor);
         DrawRectangleLines(buttonX, modeButtonY, buttonWidth, buttonHeight,
                            RAYWHITE);
-        DrawText(mode ? "schip" : "chip8", buttonX + 15, modeButtonY + 10, 20,
-                 RAYWHITE);
+        DrawText(mode == 2 ? "xochip" : mode ? "schip" : "chip8",
+                 buttonX + 15, modeButtonY + 10, 20, RAYWHITE);
         // --- Handle button clicks ---
 
-        if (CheckCollisionPointRec(
+        if (!netplay
+            && CheckCollisionPointRec(
                 GetMousePosition(),
                 (Rectangle){buttonX, buttonY, buttonWidth, buttonHeight})
             && IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
             reload();
         }
 
-        if (CheckCollisionPointRec(
+        if (!netplay
+            && CheckCollisionPointRec(
                 GetMousePosition(),
                 (Rectangle){pauseButtonX, buttonY, buttonWidth, buttonHeight})
             && IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
@@ -146,16 +205,18 @@ int main(int argc, char **argv) {
             isPaused = isPaused ? 0 : 1;
         }
 
-        if (CheckCollisionPointRec(
+        if (!netplay
+            && CheckCollisionPointRec(
                 GetMousePosition(),
                 (Rectangle){buttonX, modeButtonY, buttonWidth, buttonHeight})
             && IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
-            mode = mode ? 0 : 1;
+            mode = (mode + 1) % 3;
             setMode(mode);
         }
 
         EndDrawing();
     }
+    if (netplay) netplayStop();
     CloseWindow(); 
 
     return 0;
@@ -0,0 +1,157 @@
+#include "recorder.h"
+#include "chip8.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define OUTPUT_BUFFER_SIZE (1 << 20)
+
+static struct {
+    FILE *out;
+    uint8_t *buffer; // output is collected here and written in large blocks
+    int used;
+    uint32_t ticks;  // ticks since the last written frame
+    uint8_t flags;   // flags of the last written frame
+    uint8_t prev[RECORDER_FRAME_SIZE];
+    uint8_t cur[RECORDER_FRAME_SIZE];
+    uint8_t encoded[RECORDER_FRAME_SIZE + RECORDER_FRAME_SIZE / 128 + 1];
+} rec;
+
+static void flushOutput() {
+    if (rec.used) fwrite(rec.buffer, 1, rec.used, rec.out);
+    rec.used = 0;
+}
+
+static void emit(const void *data, int length) {
+    if (rec.used + length > OUTPUT_BUFFER_SIZE) flushOutput();
+    memcpy(&rec.buffer[rec.used], data, length);
+    rec.used += length;
+}
+
+static void writeVarint(uint32_t value) {
+    uint8_t bytes[5];
+    int n = 0;
+    do {
+        bytes[n] = value & 0x7F;
+        value >>= 7;
+        if (value) bytes[n] |= 0x80;
+        n++;
+    } while (value);
+    emit(bytes, n);
+}
+
+int recorderOpen(const char *path) {
+    if (rec.out) recorderClose();
+    rec.buffer = malloc(OUTPUT_BUFFER_SIZE);
+    if (!rec.buffer) {
+        fprintf(stderr, "Unable to allocate recorder buffer\n");
+        return 0;
+    }
+    rec.out = strcmp(path, "-") == 0 ? stdout : fopen(path, "wb");
+    if (!rec.out) {
+        perror(path);
+        free(rec.buffer);
+        rec.buffer = NULL;
+        return 0;
+    }
+    rec.used = 0;
+    emit(RECORDER_MAGIC, 4);
+    emit(&(uint8_t){RECORDER_VERSION}, 1);
+    rec.ticks = 0;
+    rec.flags = 0xFF; // forces the first frame to be a key frame
+    return 1;
+}
+
+// Pack the current display into rec.cur, returns the packed size
+static int packFrame(int planes) {
+    int width = chip8.hires ? 128 : 64;
+    int height = chip8.hires ? 64 : 32;
+    int words = width / 64;
+    uint8_t *out = rec.cur;
+
+    if (chip8.xochip) {
+        // the bitplanes are already packed, only the byte order changes
+        for (int p = 0; p < planes; p++) {
+            for (int y = 0; y < height; y++) {
+                for (int w = 0; w < words; w++) {
+                    uint64_t v = chip8.planes[p][y][w];
+                    for (int b = 7; b >= 0; b--) *out++ = v >> (b * 8);
+                }
+            }
+        }
+        return out - rec.cur;
+    }
+
+    const uint8_t *display = chip8.display;
+    for (int i = 0; i < width * height; i += 8) {
+        *out++ = (display[i] & 1) << 7 | (display[i + 1] & 1) << 6
+                 | (display[i + 2] & 1) << 5 | (display[i + 3] & 1) << 4
+                 | (display[i + 4] & 1) << 3 | (display[i + 5] & 1) << 2
+                 | (display[i + 6] & 1) << 1 | (display[i + 7] & 1);
+    }
+    return out - rec.cur;
+}
+
+// XOR rec.cur against rec.prev and run-length code it into rec.encoded
+static int encodeFrame(int size) {
+    uint8_t *out = rec.encoded;
+    int i = 0;
+
+    // whole words first, a scroll or small sprite leaves most of them zero
+    for (int w = 0; w < size / 8; w++) {
+        uint64_t a, b;
+        memcpy(&a, &rec.cur[w * 8], 8);
+        memcpy(&b, &rec.prev[w * 8], 8);
+        a ^= b;
+        memcpy(&rec.prev[w * 8], &rec.cur[w * 8], 8);
+        memcpy(&rec.cur[w * 8], &a, 8);
+    }
+
+    while (i < size) {
+        int start = i;
+        if (rec.cur[i] == 0) {
+            while (i < size && i - start < 128 && rec.cur[i] == 0) i++;
+            *out++ = 0x80 | (i - start - 1);
+        } else {
+            // stop a literal at a pair of zeros, a run is cheaper there
+            while (i < size && i - start < 128
+                   && !(rec.cur[i] == 0 && i + 1 < size && rec.cur[i + 1] == 0))
+                i++;
+            *out++ = i - start - 1;
+            memcpy(out, &rec.cur[start], i - start);
+            out += i - start;
+        }
+    }
+    return out - rec.encoded;
+}
+
+void recorderFrame() {
+    if (!rec.out) return;
+    rec.ticks++;
+    if (!isDisplayUpdated()) return;
+
+    int planes = chip8.xochip ? XO_PLANES : 1;
+    uint8_t flags = (chip8.hires ? 1 : 0) | (planes - 1) << 1;
+    int size = packFrame(planes);
+    if (flags != rec.flags) {
+        memset(rec.prev, 0, sizeof(rec.prev));
+        rec.flags = flags;
+    }
+    int length = encodeFrame(size);
+
+    writeVarint(rec.ticks);
+    emit(&flags, 1);
+    writeVarint(length);
+    emit(rec.encoded, length);
+    rec.ticks = 0;
+}
+
+void recorderClose() {
+    if (!rec.out) return;
+    flushOutput();
+    fflush(rec.out);
+    if (rec.out != stdout) fclose(rec.out);
+    free(rec.buffer);
+    rec.buffer = NULL;
+    rec.out = NULL;
+}
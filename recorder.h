@@ -0,0 +1,48 @@
+/*
+    Frame stream recorder
+    Records the display to a file or pipe while the emulator runs, without
+    needing a window. Call recorderFrame() once per tick (after chip8Tick);
+    only frames where isDisplayUpdated() reports a change are written.
+
+    Each frame is packed to one bit per pixel per plane, XORed against the
+    previous frame and run-length coded, so an unchanged region costs almost
+    nothing. Output is collected in a 1 MB buffer and written in large
+    blocks so recording keeps up with uncapped emulation.
+
+    Stream format:
+        header:  "C8RC" version(1)
+        frame:   varint ticks since previous frame
+                 flags: bit 0 hires, bits 1-2 planes - 1
+                 varint encoded length, then encoded bytes
+    Varints are LEB128: 7 bits per byte, least significant group first,
+    with the top bit set on every byte except the last.
+    A frame whose flags differ from the previous one is XORed against an
+    empty frame. Encoded bytes are a sequence of control bytes: 0x80 | n is
+    a run of n + 1 zero bytes, n is followed by n + 1 literal bytes.
+    The packed frame is planes * height rows of width / 8 bytes, pixel 0 in
+    the MSB. player.c decodes the stream.
+
+    Core and recorder diagnostics go to stderr, so recording to stdout
+    keeps the stream intact.
+*/
+
+#ifndef CHIP8_RECORDER_H
+#define CHIP8_RECORDER_H
+
+#define RECORDER_MAGIC "C8RC"
+#define RECORDER_VERSION 1
+// largest packed frame: four 128 * 64 planes
+#define RECORDER_FRAME_SIZE (4 * 128 * 64 / 8)
+
+// Start recording to path, "-" records to stdout
+// returns 1 on success, 0 on failure
+int recorderOpen(const char *path);
+
+// Record the display if it changed since the last call
+// This consumes the isDisplayUpdated() flag
+void recorderFrame();
+
+// Flush and close the recording
+void recorderClose();
+
+#endif
@@ -0,0 +1,103 @@
+/*
+    relay.c
+    UDP relay for testing netplay on one machine. Peers send their packets
+    here and each one is forwarded to the other player, whose address is
+    learned from the packets it sends. An optional delay and loss rate
+    simulate a real connection.
+
+    Usage: relay [port] [delay ms] [loss percent]
+*/
+
+#include "netplay.h"
+#include <arpa/inet.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define QUEUE_SIZE 1024
+
+struct queued {
+    long due; // ms
+    int to;   // player slot
+    int length;
+    uint8_t data[NETPLAY_PACKET_SIZE];
+};
+
+static struct queued queue[QUEUE_SIZE];
+static int queueHead;
+static int queueCount;
+
+static long nowMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+int main(int argc, char **argv) {
+    int port = argc > 1 ? atoi(argv[1]) : NETPLAY_PORT;
+    int delay = argc > 2 ? atoi(argv[2]) : 0;
+    int loss = argc > 3 ? atoi(argv[3]) : 0;
+    struct sockaddr_in peers[2];
+    int known[2] = {0, 0};
+    struct sockaddr_in local = {0};
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    local.sin_family = AF_INET;
+    local.sin_port = htons(port);
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (sock < 0 || bind(sock, (struct sockaddr *)&local, sizeof(local)) < 0) {
+        perror("relay socket");
+        return 1;
+    }
+    printf("relay on port %d, delay %d ms, loss %d%%\n", port, delay, loss);
+    fflush(stdout);
+
+    for (;;) {
+        struct pollfd fd = {sock, POLLIN, 0};
+        int timeout = -1;
+        if (queueCount) {
+            long wait = queue[queueHead].due - nowMs();
+            timeout = wait > 0 ? (int)wait : 0;
+        }
+        poll(&fd, 1, timeout);
+
+        if (fd.revents & POLLIN) {
+            struct sockaddr_in from;
+            socklen_t fromLength = sizeof(from);
+            uint8_t data[NETPLAY_PACKET_SIZE];
+            int length = recvfrom(sock, data, sizeof(data), 0,
+                                  (struct sockaddr *)&from, &fromLength);
+            if (length >= 6 && memcmp(data, NETPLAY_MAGIC, 4) == 0
+                && data[5] < 2) {
+                int player = data[5];
+                if (!known[player]) printf("player %d joined\n", player);
+                peers[player] = from;
+                known[player] = 1;
+                if (known[!player] && queueCount < QUEUE_SIZE
+                    && rand() % 100 >= loss) {
+                    struct queued *q
+                        = &queue[(queueHead + queueCount) % QUEUE_SIZE];
+                    q->due = nowMs() + delay;
+                    q->to = !player;
+                    q->length = length;
+                    memcpy(q->data, data, length);
+                    queueCount++;
+                }
+                fflush(stdout);
+            }
+        }
+
+        // delay is the same for every packet, so the queue stays in order
+        while (queueCount && queue[queueHead].due <= nowMs()) {
+            struct queued *q = &queue[queueHead];
+            sendto(sock, q->data, q->length, 0,
+                   (struct sockaddr *)&peers[q->to], sizeof(peers[q->to]));
+            queueHead = (queueHead + 1) % QUEUE_SIZE;
+            queueCount--;
+        }
+    }
+}
@@ -0,0 +1,21 @@
+#include "rombundle.h"
+#include "chip8.h"
+#include <stdio.h>
+#include <string.h>
+
+int findBundledROM(const char *name) {
+    for (int i = 0; i < romCount; i++) {
+        if (strcmp(romIndex[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+int loadBundledROM(const char *name) {
+    int i = findBundledROM(name);
+    if (i < 0) {
+        fprintf(stderr, "ROM %s not in bundle\n", name);
+        return 0;
+    }
+    loadROMInPlace(&romBundle[romIndex[i].offset], romIndex[i].length);
+    return 1;
+}
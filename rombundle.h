@@ -0,0 +1,31 @@
+/*
+    ROM bundle
+    The ROMs in roms/ are packed at build time by rompack into romdata.c.
+    romBundle holds the data of every ROM back to back and romIndex
+    describes where each one starts. Loading a bundled ROM reads it in
+    place, so no fetch or heap allocation is needed.
+*/
+
+#ifndef CHIP8_ROMBUNDLE_H
+#define CHIP8_ROMBUNDLE_H
+
+#include <stdint.h>
+
+struct romEntry {
+    const char *name; // file name without the roms/ prefix
+    int offset;       // start of the ROM in romBundle
+    int length;
+};
+
+extern const uint8_t romBundle[];
+extern const struct romEntry romIndex[];
+extern const int romCount;
+
+// returns the index of the named ROM, or -1 if it is not in the bundle
+int findBundledROM(const char *name);
+
+// load the named ROM from the bundle
+// returns 1 on success, 0 if the ROM is not in the bundle
+int loadBundledROM(const char *name);
+
+#endif
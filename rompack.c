@@ -0,0 +1,73 @@
+/*
+    rompack.c
+    Build time tool that packs the ROMs in roms/ into a single C source file.
+    All ROM data is stored back to back in one array, followed by an index of
+    name, offset and length, so the web build can load a ROM straight out of
+    WASM memory without fetching or copying it first.
+
+    Usage: rompack roms/a.ch8 roms/b.ch8 ... > romdata.c
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *baseName(const char *path) {
+    const char *slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+// print s as the contents of a C string literal
+static void printEscaped(const char *s) {
+    for (; *s; s++) {
+        unsigned char c = *s;
+        if (c == '"' || c == '\\') printf("\\%c", c);
+        else if (c < 0x20 || c >= 0x7F) printf("\\%03o", c);
+        else putchar(c);
+    }
+}
+
+int main(int argc, char **argv) {
+    long *lengths = calloc(argc, sizeof(long));
+    long offset = 0;
+    if (!lengths) {
+        perror("calloc");
+        return 1;
+    }
+
+    printf("/* Generated by rompack, do not edit */\n\n");
+    printf("#include \"rombundle.h\"\n\n");
+    printf("const uint8_t romBundle[] = {\n");
+    for (int i = 1; i < argc; i++) {
+        FILE *f = fopen(argv[i], "rb");
+        if (!f) {
+            perror(argv[i]);
+            return 1;
+        }
+        int c;
+        // names can end in a backslash, which would continue a // comment
+        // onto the data, so only the index number is written here
+        printf("    // romIndex[%d]\n   ", i - 1);
+        while ((c = fgetc(f)) != EOF) {
+            printf(" 0x%02x,", c);
+            if (++lengths[i] % 12 == 0) printf("\n   ");
+        }
+        printf("\n");
+        fclose(f);
+    }
+    // keep the array non-empty when there are no ROMs
+    printf("    0x00\n};\n\n");
+
+    printf("const struct romEntry romIndex[] = {\n");
+    for (int i = 1; i < argc; i++) {
+        printf("    {\"");
+        printEscaped(baseName(argv[i]));
+        printf("\", %ld, %ld},\n", offset, lengths[i]);
+        offset += lengths[i];
+    }
+    printf("    {0, 0, 0}\n};\n\n");
+    printf("const int romCount = %d;\n", argc - 1);
+
+    free(lengths);
+    return 0;
+}